@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr int frames = 600;
+	static constexpr float frame_delta = 1.0f / 60.0f;
+
+	// Virtual interface stepped one animation at a time, as AnimationManager used to do.
+	class ListAnimation
+	{
+	public:
+		virtual ~ListAnimation(void) { }
+		virtual bool is_done(void) const = 0;
+		virtual void step(float delta) = 0;
+	};
+
+	class ListValueAnimation : public ListAnimation
+	{
+	private:
+		std::vector<AnimationKey<float>> keys;
+		int next_key;
+		float time;
+		float* attribute;
+		float value_delta;
+
+	public:
+		ListValueAnimation(float* attribute) : next_key(0), time(0.0f), attribute(attribute), value_delta(0.0f) { }
+
+		void add_key(const AnimationKey<float>& key) { keys.push_back(key); }
+		void start(void) { value_delta = (keys.front().value - *attribute) / keys.front().index; }
+		bool is_done(void) const { return next_key == static_cast<int>(keys.size()); }
+
+		void step(float delta)
+		{
+			auto next = keys.begin() + next_key;
+			if (next->mode == AnimationKey<float>::Continuous)
+			{
+				*attribute += value_delta * delta;
+			}
+			if (time >= next->index)
+			{
+				*attribute = next->value;
+				next_key++;
+				++next;
+				if (next != keys.end())
+				{
+					value_delta = (next->value - *attribute) / (next->index - time);
+				}
+			}
+			time += delta;
+		}
+	};
+
+	class ListAnimationManager
+	{
+	private:
+		std::list<std::unique_ptr<ListAnimation>> animations;
+
+	public:
+		void add(std::unique_ptr<ListAnimation> animation) { animations.push_back(std::move(animation)); }
+
+		void update(float delta)
+		{
+			for (auto it = animations.begin(); it != animations.end(); )
+			{
+				(*it)->step(delta);
+				if ((*it)->is_done())
+					it = animations.erase(it);
+				else
+					++it;
+			}
+		}
+	};
+
+	// Keys of a tween that runs for most of the benchmark.
+	static std::vector<AnimationKey<float>> create_keys(void)
+	{
+		std::vector<AnimationKey<float>> keys;
+		auto time = 0.0f;
+		for (auto i = 0; i < 4; i++)
+		{
+			time += randf(0.5f, 3.0f);
+			keys.push_back(AnimationKey<float>(time, randf(-100.0f, 100.0f)));
+		}
+		return keys;
+	}
+
+	// Returns the time per update in microseconds.
+	template <typename T>
+	static double bench_update(T& manager)
+	{
+		return measure(frames, [&](void) { manager.update(frame_delta); }) * 1000.0;
+	}
+
+	void bench_animations(void)
+	{
+		std::cout << "animations: stepping float tweens for " << frames << " frames (us / update)" << std::endl;
+		std::cout << std::setw(10) << "count" << std::setw(12) << "list" << std::setw(12) << "pool"
+			<< std::setw(12) << "match" << std::endl;
+		for (auto count : { 1000, 10000, 100000 })
+		{
+			std::vector<float> list_values(count), pool_values(count);
+			ListAnimationManager list_manager;
+			AnimationManager pool_manager(nullptr);
+			srand(42);
+			for (auto i = 0; i < count; i++)
+			{
+				const auto keys = create_keys();
+				auto list_anim = std::make_unique<ListValueAnimation>(&list_values[i]);
+				auto pool_anim = std::make_unique<ValueAnimation<float>>(&pool_values[i]);
+				for (const auto& key : keys)
+				{
+					list_anim->add_key(key);
+					pool_anim->add_key(key);
+				}
+				list_anim->start();
+				list_manager.add(std::move(list_anim));
+				pool_manager.add(std::move(pool_anim));
+			}
+
+			const auto list_time = bench_update(list_manager);
+			const auto pool_time = bench_update(pool_manager);
+			std::cout << std::fixed << std::setprecision(1) << std::setw(10) << count
+				<< std::setw(12) << list_time << std::setw(12) << pool_time
+				<< std::setw(12) << (list_values == pool_values ? "yes" : "no") << std::endl;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+// benchmarkapp.cpp : Defines the entry point for the console application.
+//
+
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	double measure(int iterations, const std::function<void(void)>& fn)
+	{
+		Stopwatch sw;
+		for (auto i = 0; i < iterations; i++)
+		{
+			fn();
+		}
+		return sw.elapsed_ms() / static_cast<double>(iterations);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// Available benchmark suites, selected by name from the command line.
+	const std::vector<std::pair<std::string, std::function<void(void)>>> suites = {
+		{ "animations", dukat::bench_animations },
+		{ "collision", dukat::bench_collision },
+		{ "events", dukat::bench_events },
+		{ "particles", dukat::bench_particles },
+		{ "queries", dukat::bench_queries },
+		{ "sprites", dukat::bench_sprites },
+		{ "timers", dukat::bench_timers }
+	};
+
+	try
+	{
+		std::string suite = argc > 1 ? argv[1] : "";
+		auto found = false;
+		for (const auto& s : suites)
+		{
+			if (suite.empty() || suite == s.first)
+			{
+				s.second();
+				found = true;
+			}
+		}
+
+		if (!found)
+		{
+			std::cerr << "Usage: benchmark [suite]" << std::endl << "Suites:";
+			for (const auto& s : suites)
+			{
+				std::cerr << " " << s.first;
+			}
+			std::cerr << std::endl;
+			return -1;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Benchmark failed with error: " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <dukat/dukat.h>
+
+namespace dukat
+{
+	// Measures wall-clock time using the high-resolution clock.
+	class Stopwatch
+	{
+	private:
+		std::chrono::high_resolution_clock::time_point start_time;
+
+	public:
+		Stopwatch(void) { start(); }
+		~Stopwatch(void) { }
+
+		void start(void) { start_time = std::chrono::high_resolution_clock::now(); }
+		// Returns the time since start in milliseconds.
+		double elapsed_ms(void) const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+		}
+	};
+
+	// Runs a function for a number of iterations and returns the average time per iteration in milliseconds.
+	double measure(int iterations, const std::function<void(void)>& fn);
+
+	// Benchmark suites
+	void bench_animations(void);
+	void bench_collision(void);
+	void bench_events(void);
+	void bench_particles(void);
+	void bench_queries(void);
+	void bench_sprites(void);
+	void bench_timers(void);
+}
@@ -0,0 +1,303 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr float world_size = 10000.0f;
+	static constexpr int world_depth = 6;
+	static constexpr int frames = 100;
+	static constexpr float frame_delta = 1.0f / 60.0f;
+	// Fraction of bodies that move during the benchmark.
+	static constexpr float dynamic_ratio = 0.1f;
+
+	// Minimal body used to exercise the quadtree directly.
+	struct BenchBody
+	{
+		AABB2 bb;
+		Vector2 dir;
+		bool dynamic;
+		QuadTree<BenchBody>* node;
+	};
+
+	// Height of the world in relation to its width for strip scenes.
+	static constexpr float strip_ratio = 0.01f;
+
+	static void create_scene(int count, std::vector<BenchBody>& bodies, bool strip = false, float size = world_size)
+	{
+		srand(42);
+		const Vector2 half_world{ 0.5f * size, 0.5f * size * (strip ? strip_ratio : 1.0f) };
+		bodies.resize(count);
+		for (auto i = 0; i < count; i++)
+		{
+			auto& b = bodies[i];
+			auto pos = Vector2::random(-half_world, half_world);
+			auto size = randf(2.0f, 8.0f);
+			b.bb = AABB2{ pos - Vector2{ size, size }, pos + Vector2{ size, size } };
+			b.dynamic = i < static_cast<int>(dynamic_ratio * count);
+			b.dir = b.dynamic ? Vector2{ randf(-50.0f, 50.0f), randf(-50.0f, 50.0f) } : Vector2{ 0.0f, 0.0f };
+			b.node = nullptr;
+		}
+	}
+
+	static void move_bodies(std::vector<BenchBody>& bodies, bool strip = false)
+	{
+		const auto limit = 0.5f * world_size;
+		const auto limit_y = strip ? strip_ratio * limit : limit;
+		for (auto& b : bodies)
+		{
+			if (!b.dynamic)
+				continue;
+			if (b.bb.min.x < -limit || b.bb.max.x > limit)
+				b.dir.x = -b.dir.x;
+			if (b.bb.min.y < -limit_y || b.bb.max.y > limit_y)
+				b.dir.y = -b.dir.y;
+			b.bb += b.dir * frame_delta;
+		}
+	}
+
+	// Clears and re-populates a single tree every frame.
+	static double bench_rebuild(std::vector<BenchBody>& bodies)
+	{
+		const Vector2 half_world{ 0.5f * world_size, 0.5f * world_size };
+		QuadTree<BenchBody> tree(-half_world, half_world, world_depth);
+		return measure(frames, [&](void) {
+			move_bodies(bodies);
+			tree.clear();
+			for (auto& b : bodies)
+			{
+				tree.insert(&b);
+			}
+		});
+	}
+
+	// Keeps static bodies in a separate tree and only moves bodies that left their node.
+	static double bench_incremental(std::vector<BenchBody>& bodies)
+	{
+		const Vector2 half_world{ 0.5f * world_size, 0.5f * world_size };
+		QuadTree<BenchBody> static_tree(-half_world, half_world, world_depth);
+		QuadTree<BenchBody> dynamic_tree(-half_world, half_world, world_depth);
+		for (auto& b : bodies)
+		{
+			b.node = (b.dynamic ? dynamic_tree : static_tree).insert(&b);
+		}
+		return measure(frames, [&](void) {
+			move_bodies(bodies);
+			for (auto& b : bodies)
+			{
+				b.node = b.node->relocate(&b);
+			}
+		});
+	}
+
+	// Runs the complete collision manager update, including the narrow phase.
+	static double bench_manager(const std::vector<BenchBody>& scene, CollisionManager2::BroadPhase broad_phase, 
+		bool strip = false, WorkerPool* pool = nullptr)
+	{
+		CollisionManager2 cm(nullptr);
+		cm.set_world_size(world_size);
+		cm.set_world_depth(world_depth);
+		cm.set_broad_phase(broad_phase);
+		cm.set_worker_pool(pool);
+		std::vector<BenchBody> bodies(scene);
+		std::vector<CollisionManager2::Body*> handles;
+		for (const auto& b : bodies)
+		{
+			auto body = cm.create_body(b.dynamic);
+			body->bb = b.bb;
+			body->solid = false; // keep scene stable across runs
+			handles.push_back(body);
+		}
+		return measure(frames, [&](void) {
+			move_bodies(bodies, strip);
+			for (auto i = 0u; i < bodies.size(); i++)
+			{
+				handles[i]->bb = bodies[i].bb;
+			}
+			cm.update(frame_delta);
+		});
+	}
+
+	void bench_collision(void)
+	{
+		std::cout << "collision: broad phase update (ms / frame, " << static_cast<int>(dynamic_ratio * 100.0f)
+			<< "% dynamic bodies)" << std::endl;
+		std::cout << std::setw(10) << "bodies" << std::setw(12) << "rebuild"
+			<< std::setw(14) << "incremental" << std::setw(12) << "manager" << std::setw(12) << "sap" << std::endl;
+		for (auto count : { 1000, 10000, 50000 })
+		{
+			std::vector<BenchBody> scene;
+			create_scene(count, scene);
+			std::vector<BenchBody> bodies(scene);
+			auto rebuild = bench_rebuild(bodies);
+			bodies = scene;
+			auto incremental = bench_incremental(bodies);
+			auto manager = bench_manager(scene, CollisionManager2::QUAD_TREE);
+			auto sap = bench_manager(scene, CollisionManager2::SWEEP_AND_PRUNE);
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count << std::setw(12) << rebuild
+				<< std::setw(14) << incremental << std::setw(12) << manager << std::setw(12) << sap << std::endl;
+		}
+
+		// Long, thin worlds put most bodies into the root node of the quadtree.
+		std::cout << std::endl << "collision: strip world update (ms / frame)" << std::endl;
+		std::cout << std::setw(10) << "bodies" << std::setw(12) << "manager" << std::setw(12) << "sap" << std::endl;
+		for (auto count : { 1000, 10000 })
+		{
+			std::vector<BenchBody> scene;
+			create_scene(count, scene, true);
+			auto manager = bench_manager(scene, CollisionManager2::QUAD_TREE, true);
+			auto sap = bench_manager(scene, CollisionManager2::SWEEP_AND_PRUNE, true);
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count << std::setw(12) << manager
+				<< std::setw(12) << sap << std::endl;
+		}
+
+		// Dense scene with plenty of contacts to exercise the narrow phase.
+		const auto scaling_bodies = 20000;
+		std::cout << std::endl << "collision: narrow phase scaling, " << scaling_bodies << " bodies (ms / frame)" << std::endl;
+		std::cout << std::setw(10) << "threads" << std::setw(12) << "manager" << std::setw(12) << "sap"
+			<< std::setw(12) << "speedup" << std::endl;
+		std::vector<BenchBody> scene;
+		create_scene(scaling_bodies, scene, false, 0.2f * world_size);
+		const auto max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		auto serial = 0.0;
+		for (auto threads = 1; threads <= max_threads; threads *= 2)
+		{
+			WorkerPool pool(threads - 1);
+			auto manager = bench_manager(scene, CollisionManager2::QUAD_TREE, false, &pool);
+			auto sap = bench_manager(scene, CollisionManager2::SWEEP_AND_PRUNE, false, &pool);
+			if (threads == 1)
+				serial = manager;
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << threads << std::setw(12) << manager
+				<< std::setw(12) << sap << std::setw(12) << serial / manager << std::endl;
+		}
+
+		// Replaces a share of bodies every frame, as spawning projectiles would.
+		std::cout << std::endl << "collision: destroy and re-create 10% of bodies (ms / frame)" << std::endl;
+		std::cout << std::setw(10) << "bodies" << std::setw(12) << "churn" << std::endl;
+		for (auto count : { 1000, 10000, 50000 })
+		{
+			create_scene(count, scene);
+			CollisionManager2 cm(nullptr);
+			cm.set_world_size(world_size);
+			cm.set_world_depth(world_depth);
+			std::vector<CollisionManager2::Body*> handles;
+			for (const auto& b : scene)
+			{
+				auto body = cm.create_body(b.dynamic);
+				body->bb = b.bb;
+				handles.push_back(body);
+			}
+			cm.update(frame_delta);
+			auto next = 0u;
+			auto churn = measure(frames, [&](void) {
+				for (auto i = 0; i < count / 10; i++, next = (next + 7919) % handles.size())
+				{
+					const auto bb = handles[next]->bb;
+					const auto dynamic = handles[next]->dynamic;
+					cm.destroy_body(handles[next]);
+					handles[next] = cm.create_body(dynamic);
+					handles[next]->bb = bb;
+				}
+			});
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count << std::setw(12) << churn << std::endl;
+		}
+	}
+
+	// Compares batched manager queries with scanning all bodies.
+	void bench_queries(void)
+	{
+		const auto num_bodies = 10000;
+		const auto num_queries = 1000;
+		const auto k = 4;
+		const auto mask = 0xffffffff;
+		std::vector<BenchBody> scene;
+		create_scene(num_bodies, scene);
+
+		CollisionManager2 cm(nullptr);
+		cm.set_world_size(world_size);
+		cm.set_world_depth(world_depth);
+		std::vector<CollisionManager2::Body*> handles;
+		for (const auto& b : scene)
+		{
+			auto body = cm.create_body(b.dynamic);
+			body->bb = b.bb;
+			body->solid = false;
+			handles.push_back(body);
+		}
+		cm.update(frame_delta);
+
+		const Vector2 half_world{ 0.5f * world_size, 0.5f * world_size };
+		std::vector<AABB2> boxes;
+		std::vector<Ray2> rays;
+		std::vector<Vector2> points;
+		for (auto i = 0; i < num_queries; i++)
+		{
+			auto p = Vector2::random(-half_world, half_world);
+			boxes.push_back(AABB2{ p - Vector2{ 100.0f, 100.0f }, p + Vector2{ 100.0f, 100.0f } });
+			rays.push_back(Ray2{ p, Vector2{ randf(-500.0f, 500.0f), randf(-500.0f, 500.0f) } });
+			points.push_back(p);
+		}
+
+		const auto max_results = 64;
+		std::vector<CollisionManager2::Body*> res(num_queries * std::max(k, max_results));
+		std::vector<int> counts(num_queries);
+		std::vector<CollisionManager2::RayHit> hits(num_queries);
+
+		auto brute_area = measure(10, [&](void) {
+			for (auto i = 0; i < num_queries; i++)
+			{
+				auto count = 0;
+				for (auto b : handles)
+				{
+					if (count < max_results && boxes[i].overlaps(b->bb))
+						res[i * max_results + count++] = b;
+				}
+				counts[i] = count;
+			}
+		});
+		auto brute_ray = measure(10, [&](void) {
+			for (auto i = 0; i < num_queries; i++)
+			{
+				hits[i] = CollisionManager2::RayHit{ nullptr, 1.0f };
+				for (auto b : handles)
+				{
+					auto t = b->bb.intersect_ray(rays[i], 0.0f, hits[i].t);
+					if (t != no_intersection && (hits[i].body == nullptr || t < hits[i].t))
+						hits[i] = CollisionManager2::RayHit{ b, std::max(0.0f, t) };
+				}
+			}
+		});
+		auto brute_nearest = measure(10, [&](void) {
+			for (auto i = 0; i < num_queries; i++)
+			{
+				std::partial_sort(handles.begin(), handles.begin() + k, handles.end(), [&](CollisionManager2::Body* a, CollisionManager2::Body* b) {
+					return (a->bb.center() - points[i]).mag2() < (b->bb.center() - points[i]).mag2();
+				});
+				std::copy(handles.begin(), handles.begin() + k, res.begin() + i * k);
+			}
+		});
+
+		std::cout << "queries: " << num_queries << " queries against " << num_bodies << " bodies (ms / batch)" << std::endl;
+		std::cout << std::setw(10) << "threads" << std::setw(12) << "area" << std::setw(12) << "ray"
+			<< std::setw(12) << "nearest" << std::endl;
+		std::cout << std::fixed << std::setprecision(3) << std::setw(10) << "brute" << std::setw(12) << brute_area
+			<< std::setw(12) << brute_ray << std::setw(12) << brute_nearest << std::endl;
+		const auto max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		for (auto threads = 1; threads <= max_threads; threads *= 2)
+		{
+			WorkerPool pool(threads - 1);
+			cm.set_worker_pool(&pool);
+			auto area = measure(10, [&](void) {
+				cm.query_area(boxes.data(), num_queries, mask, res.data(), max_results, counts.data());
+			});
+			auto ray = measure(10, [&](void) {
+				cm.query_ray(rays.data(), num_queries, 1.0f, mask, hits.data());
+			});
+			auto nearest = measure(10, [&](void) {
+				cm.query_nearest(points.data(), num_queries, k, mask, res.data(), counts.data());
+			});
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << threads << std::setw(12) << area
+				<< std::setw(12) << ray << std::setw(12) << nearest << std::endl;
+		}
+		cm.set_worker_pool(nullptr);
+	}
+}
\ No newline at end of file
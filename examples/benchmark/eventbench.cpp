@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr int triggers = 1000000;
+
+	// Counts received messages, so dispatch cannot be optimized away.
+	class CountingRecipient : public Recipient
+	{
+	public:
+		int received;
+
+		CountingRecipient(void) : received(0) { }
+		void receive(const Message& msg) { received++; }
+	};
+
+	// Dispatch through a hash map of ordered sets, as Messenger used to do.
+	class SetMessenger
+	{
+	private:
+		std::unordered_map<Event, std::set<Recipient*>> subscriptions;
+
+	public:
+		void trigger(const Message& message)
+		{
+			if (subscriptions.count(message.event))
+			{
+				for (auto r : subscriptions[message.event])
+				{
+					r->receive(message);
+				}
+			}
+		}
+
+		void subscribe(Event ev, Recipient* recipient) { subscriptions[ev].insert(recipient); }
+	};
+
+	// Returns the time per trigger in nanoseconds.
+	template <typename T>
+	static double bench_dispatch(T& messenger)
+	{
+		const Vector2 shift{ 1.0f, 0.0f };
+		return measure(1, [&](void) {
+			for (auto i = 0; i < triggers; i++)
+			{
+				messenger.trigger(Message{ Events::CollisionResolve, &shift });
+			}
+		}) * 1000000.0 / static_cast<double>(triggers);
+	}
+
+	void bench_events(void)
+	{
+		std::cout << "events: dispatching " << triggers << " messages (ns / trigger)" << std::endl;
+		std::cout << std::setw(12) << "recipients" << std::setw(12) << "set" << std::setw(12) << "flat" << std::endl;
+		for (auto count : { 1, 4, 16 })
+		{
+			std::vector<CountingRecipient> recipients(count);
+			SetMessenger set_messenger;
+			Messenger messenger;
+			for (auto& r : recipients)
+			{
+				// subscribe to neighbouring events as well, as game objects typically do
+				for (auto ev : { Events::CollisionBegin, Events::CollisionEnd, Events::CollisionResolve })
+				{
+					set_messenger.subscribe(ev, &r);
+					messenger.subscribe(ev, &r);
+				}
+			}
+
+			const auto set_time = bench_dispatch(set_messenger);
+			const auto flat_time = bench_dispatch(messenger);
+			std::cout << std::fixed << std::setprecision(1) << std::setw(12) << count
+				<< std::setw(12) << set_time << std::setw(12) << flat_time << std::endl;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr int frames = 60;
+	static constexpr float frame_delta = 1.0f / 60.0f;
+
+	// Fills a store with particles that expire over the course of a few seconds.
+	static void create_particles(int count, ParticleStore& store)
+	{
+		srand(42);
+		for (auto i = 0; i < count; i++)
+		{
+			Particle p;
+			p.pos = Vector2{ randf(-500.0f, 500.0f), randf(-500.0f, 500.0f) };
+			p.dp = Vector2{ randf(-20.0f, 20.0f), randf(-20.0f, 20.0f) };
+			p.color = Color{ 1.0f, 1.0f, 1.0f, 1.0f };
+			p.dc = Color{ 0.0f, 0.0f, 0.0f, -0.2f };
+			p.size = randf(1.0f, 4.0f);
+			p.ttl = randf(0.5f, 5.0f);
+			store.add(p);
+		}
+	}
+
+	// Updates a store for a number of frames and returns the throughput in million particles per second.
+	static double bench_update(ParticleStore& store, WorkerPool* pool)
+	{
+		auto updated = 0.0;
+		auto ms = measure(frames, [&](void) {
+			updated += store.count();
+			store.update(frame_delta, pool);
+		});
+		return updated / (ms * frames) / 1000.0;
+	}
+
+	static bool same_particles(ParticleStore& a, ParticleStore& b)
+	{
+		return a.px == b.px && a.py == b.py && a.ca == b.ca && a.size == b.size && a.ttl == b.ttl;
+	}
+
+	void bench_particles(void)
+	{
+		WorkerPool pool;
+		std::cout << "particles: updating for " << frames << " frames (million particles / s)" << std::endl;
+		std::cout << std::setw(10) << "count" << std::setw(12) << "serial" << std::setw(12) << "parallel"
+			<< std::setw(12) << "threads" << std::setw(12) << "match" << std::endl;
+		for (auto count : { 10000, 100000, 1000000 })
+		{
+			ParticleStore serial(count);
+			create_particles(count, serial);
+			ParticleStore parallel(serial);
+
+			const auto serial_rate = bench_update(serial, nullptr);
+			const auto parallel_rate = bench_update(parallel, &pool);
+			std::cout << std::fixed << std::setprecision(1) << std::setw(10) << count
+				<< std::setw(12) << serial_rate << std::setw(12) << parallel_rate
+				<< std::setw(12) << pool.thread_count()
+				<< std::setw(12) << (same_particles(serial, parallel) ? "yes" : "no") << std::endl;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr int map_tiles = 320;	// tiles along each side of the map
+	static constexpr int tile_size = 16;
+	static constexpr int frames = 100;
+	static const Vector2 screen_dim{ 640.0f, 360.0f };
+
+	// Creates a tile map of static sprites.
+	static void create_tiles(std::vector<std::unique_ptr<Sprite>>& sprites)
+	{
+		for (auto y = 0; y < map_tiles; y++)
+		{
+			for (auto x = 0; x < map_tiles; x++)
+			{
+				auto sprite = std::make_unique<Sprite>();
+				sprite->w = sprite->h = tile_size;
+				sprite->p = Vector2{ static_cast<float>(x * tile_size), static_cast<float>(y * tile_size) };
+				sprite->center = Sprite::align_bottom | Sprite::align_right;
+				sprite->texture_id = (x + y) % 4;
+				sprites.push_back(std::move(sprite));
+			}
+		}
+	}
+
+	// Returns the camera box for a frame, panning across the map.
+	static AABB2 camera_bb(int frame)
+	{
+		const auto t = static_cast<float>(frame) / static_cast<float>(frames);
+		const Vector2 pos{ t * map_tiles * tile_size, 0.5f * map_tiles * tile_size };
+		return AABB2{ pos - screen_dim * 0.5f, pos + screen_dim * 0.5f };
+	}
+
+	void bench_sprites(void)
+	{
+		std::vector<std::unique_ptr<Sprite>> sprites;
+		create_tiles(sprites);
+		std::vector<Sprite*> visible;
+
+		auto frame = 0;
+		auto brute = measure(frames, [&](void) {
+			const auto bb = camera_bb(frame++);
+			visible.clear();
+			for (const auto& s : sprites)
+			{
+				if (bb.overlaps(s->bounds()))
+					visible.push_back(s.get());
+			}
+		});
+		const auto brute_visible = visible.size();
+
+		std::cout << "sprites: culling " << sprites.size() << " tiles (ms / frame)" << std::endl;
+		std::cout << std::setw(10) << "cell" << std::setw(12) << "cull" << std::setw(12) << "visible" << std::endl;
+		std::cout << std::fixed << std::setprecision(3) << std::setw(10) << "brute" << std::setw(12) << brute
+			<< std::setw(12) << brute_visible << std::endl;
+		for (auto cell_size : { 64.0f, 256.0f, 1024.0f })
+		{
+			SpriteGrid grid(cell_size);
+			for (const auto& s : sprites)
+			{
+				grid.insert(s.get());
+			}
+			frame = 0;
+			auto cull = measure(frames, [&](void) {
+				const auto bb = camera_bb(frame++);
+				visible.clear();
+				grid.query(bb, [&](Sprite* s) {
+					if (bb.overlaps(s->bounds()))
+						visible.push_back(s);
+				});
+			});
+			std::cout << std::fixed << std::setprecision(3) << std::setw(10) << static_cast<int>(cell_size)
+				<< std::setw(12) << cull << std::setw(12) << visible.size() << std::endl;
+		}
+	}
+}
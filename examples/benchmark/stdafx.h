@@ -0,0 +1,34 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "targetver.h"
+
+#include <stdio.h>
+#include <tchar.h>
+
+#endif 
+
+// STL
+#include <assert.h>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SDL
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
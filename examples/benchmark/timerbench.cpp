@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "benchmarkapp.h"
+
+namespace dukat
+{
+	static constexpr int frames = 600;
+	// Power of two, so frame and timer times are exact and both managers see the same deadlines.
+	static constexpr float frame_delta = 1.0f / 64.0f;
+
+	// Decrements every timer each frame, as TimerManager used to do.
+	class ListTimerManager
+	{
+	private:
+		struct ListTimer
+		{
+			float interval;
+			float remaining;
+			bool recurring;
+			std::function<void(void)> callback;
+		};
+
+		std::list<std::unique_ptr<ListTimer>> timers;
+
+	public:
+		void create_timer(float interval, std::function<void(void)> callback, bool recurring)
+		{
+			timers.push_back(std::make_unique<ListTimer>(ListTimer{ interval, interval, recurring, callback }));
+		}
+
+		void update(float delta)
+		{
+			for (auto it = timers.begin(); it != timers.end(); )
+			{
+				(*it)->remaining -= delta;
+				if ((*it)->remaining <= 0.0f)
+				{
+					(*it)->callback();
+					if ((*it)->recurring)
+					{
+						(*it)->remaining = (*it)->interval;
+					}
+					else
+					{
+						it = timers.erase(it);
+						continue;
+					}
+				}
+				++it;
+			}
+		}
+	};
+
+	// Creates cooldown timers, every fourth of them one-shot, and returns the time per
+	// update in microseconds. Counts how often each timer fired.
+	template <typename T>
+	static double bench_update(T& manager, int count, std::vector<int>& fired)
+	{
+		srand(42);
+		fired.assign(count, 0);
+		for (auto i = 0; i < count; i++)
+		{
+			const auto interval = static_cast<float>(rand() % (9 * 64) + 64) * frame_delta;
+			manager.create_timer(interval, [&fired, i](void) { fired[i]++; }, i % 4 != 0);
+		}
+		return measure(frames, [&](void) { manager.update(frame_delta); }) * 1000.0;
+	}
+
+	void bench_timers(void)
+	{
+		std::cout << "timers: updating timers for " << frames << " frames (us / update)" << std::endl;
+		std::cout << std::setw(10) << "count" << std::setw(12) << "list" << std::setw(12) << "wheel"
+			<< std::setw(12) << "list fired" << std::setw(12) << "wheel fired" << std::setw(12) << "match" << std::endl;
+		for (auto count : { 1000, 10000, 100000 })
+		{
+			std::vector<int> list_fired, wheel_fired;
+			ListTimerManager list_manager;
+			TimerManager wheel_manager(nullptr);
+			const auto list_time = bench_update(list_manager, count, list_fired);
+			const auto wheel_time = bench_update(wheel_manager, count, wheel_fired);
+			std::cout << std::fixed << std::setprecision(1) << std::setw(10) << count
+				<< std::setw(12) << list_time << std::setw(12) << wheel_time
+				<< std::setw(12) << std::accumulate(list_fired.begin(), list_fired.end(), 0)
+				<< std::setw(12) << std::accumulate(wheel_fired.begin(), wheel_fired.end(), 0)
+				<< std::setw(12) << (list_fired == wheel_fired ? "yes" : "no") << std::endl;
+		}
+	}
+}
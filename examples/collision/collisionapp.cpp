@@ -6,11 +6,13 @@
 
 namespace dukat
 {
-	CollisionScene::CollisionScene(Game2* game2) : Scene2(game2), animate(true), show_grid(true)
+	CollisionScene::CollisionScene(Game2* game2) : Scene2(game2), animate(true), show_grid(true), use_layers(false), use_deferred(false), world_depth(4)
 	{
 		auto cm = game->add_manager<CollisionManager2>();
 		cm->set_world_size(2000.0f);
-		cm->set_world_depth(4);
+		cm->set_world_depth(world_depth);
+		cm->set_mask_pruning(true);
+		cm->set_sleep_frames(30);
 
 		auto settings = game->get_settings();
 		// Set up default camera centered around origin
@@ -31,6 +33,7 @@ namespace dukat
 		main_layer->add(cursor.get());
 
 		// Add walls:
+		// Walls use the default layer mask and collide with all objects
 		auto wall = cm->create_body(false); // north
 		wall->bb = AABB2{ -screen_dim, Vector2{ screen_dim.x, -screen_dim.y + 16.0f } };
 		wall = cm->create_body(false); // east
@@ -68,8 +71,14 @@ namespace dukat
 			ss << "Objects: " << cm->body_count() << std::endl
 				<< "Collisions: " << cm->contact_count() << std::endl
 				<< "Tests: " << perfc.avg(PerformanceCounter::BB_CHECKS) << std::endl
+				<< "Awake: " << perfc.avg(PerformanceCounter::BODIES_AWAKE) 
+				<< " Asleep: " << perfc.avg(PerformanceCounter::BODIES_ASLEEP) << std::endl
 				<< "<Space> Pause movement" << std::endl
 				<< "<g> Toggle grid" << std::endl
+				<< "<l> Toggle layers (" << (use_layers ? "on" : "off") << ")" << std::endl
+				<< "<e> Toggle deferred events (" << (use_deferred ? "on" : "off")
+				<< ", dropped: " << game->get_event_queue()->get_dropped() << ")" << std::endl
+				<< "<d> Rebuild tree (depth " << world_depth << ")" << std::endl
 				<< "<-,+> Remove / Add object" << std::endl;
 			info_text->set_text(ss.str());
 		}, true);
@@ -117,6 +126,20 @@ namespace dukat
 			animate = !animate;
 			break;
 
+		case SDLK_l:
+			set_layers(!use_layers);
+			break;
+
+		case SDLK_e:
+			set_deferred(!use_deferred);
+			break;
+
+		case SDLK_d:
+			// Rebuilding the tree has to keep bodies that are asleep, e.g. while paused.
+			world_depth = world_depth == 4 ? 5 : 4;
+			game->get<CollisionManager2>()->set_world_depth(world_depth);
+			break;
+
 		case SDLK_g:
 			show_grid = !show_grid;
 			if (show_grid)
@@ -148,7 +171,30 @@ namespace dukat
 		auto body = game->get<CollisionManager2>()->create_body();
 		body->bb.min = pos - Vector2{ size, size };
 		body->bb.max = pos + Vector2{ size, size };
+		// alternate objects between red and blue layers
+		body->category = (objects.size() % 2 == 0) ? red_layer : blue_layer;
+		body->mask = use_layers ? (wall_layer | body->category) : 0xffffffff;
 		objects.push_back(std::make_unique<GameObject>(dir, body));
+		if (use_deferred)
+			objects.back()->set_event_queue(game->get_event_queue());
+	}
+
+	void CollisionScene::set_layers(bool use_layers)
+	{
+		this->use_layers = use_layers;
+		for (auto& o : objects)
+		{
+			o->body->mask = use_layers ? (wall_layer | o->body->category) : 0xffffffff;
+		}
+	}
+
+	void CollisionScene::set_deferred(bool use_deferred)
+	{
+		this->use_deferred = use_deferred;
+		for (auto& o : objects)
+		{
+			o->set_event_queue(use_deferred ? game->get_event_queue() : nullptr);
+		}
 	}
 
 	void CollisionScene::update(float delta)
@@ -186,10 +232,10 @@ namespace dukat
 		{
 		case Events::CollisionBegin:
 			auto other_body = static_cast<const CollisionManager2::Body*>(msg.param1);
-			auto collision = static_cast<const Collision*>(msg.param2);
+			auto contact = static_cast<const CollisionManager2::Contact*>(msg.param2);
 			if (body->dynamic && body->solid && other_body->solid)
 			{
-				if (collision->normal.x != 0.0f)
+				if (contact->collision.normal.x != 0.0f)
 				{
 					dir.x = -dir.x;
 				}
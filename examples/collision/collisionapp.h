@@ -23,6 +23,10 @@ namespace dukat
 		static constexpr int window_width = 1280;
 		static constexpr int window_height = 720;
 		static constexpr float max_speed = 50.0f;
+		// Collision layers
+		static constexpr uint32_t wall_layer = 0x1;
+		static constexpr uint32_t red_layer = 0x2;
+		static constexpr uint32_t blue_layer = 0x4;
 		Vector2 screen_dim;
 
 		RenderLayer2* main_layer;
@@ -33,9 +37,16 @@ namespace dukat
 		std::vector<std::unique_ptr<GameObject>> objects;
 		bool animate;
 		bool show_grid;
+		bool use_layers;
+		bool use_deferred;
+		int world_depth;
 
 		void remove_object(void);
 		void add_object(void);
+		// Updates object masks to collide with all objects or only with objects on the same layer.
+		void set_layers(bool use_layers);
+		// Switches objects between immediate and deferred collision events.
+		void set_deferred(bool use_deferred);
 
 	public:
 		CollisionScene(Game2* game);
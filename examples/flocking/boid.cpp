@@ -6,10 +6,10 @@ namespace dukat
 	const float neighbor_distance = 50.0f;
 	const float separation_distance = 25.0f;
 
-	Boid::Boid(Particle * p, bool predator) : p(p), predator(predator), max_speed(120.0f), max_force(0.8f)
+	Boid::Boid(const Particle& particle, bool predator) : p(particle), predator(predator), max_speed(120.0f), max_force(0.8f)
 	{
 		auto angle = randf(0, two_pi);
-		p->dp.rotate(angle);
+		p.dp.rotate(angle);
 	}
 
 	void Boid::update(const std::vector<Boid>& boids)
@@ -20,11 +20,11 @@ namespace dukat
 		auto coh = cohesion(boids);
 		// Weigh & combine
 		auto acceleration = (sep * 1.5f) + (ali * 1.0f) + (coh * 1.0f);
-		p->dp += acceleration;
-		p->dp.limit(max_speed);
+		p.dp += acceleration;
+		p.dp.limit(max_speed);
 
 		if (predator && randf(0.0, 1.0) < 0.001f)
-			p->dp = -p->dp;
+			p.dp = -p.dp;
 	}
 
 	Vector2 Boid::seperate(const std::vector<Boid>& boids) const
@@ -38,7 +38,7 @@ namespace dukat
 		for (const auto& boid : boids) 
 		{
 			// compute vector pointing away from other
-			auto diff = (p->pos - boid.p->pos);
+			auto diff = (p.pos - boid.p.pos);
 			auto dist = diff.mag();
 			if (dist > 0.0f && dist < separation_distance)
 			{
@@ -58,7 +58,7 @@ namespace dukat
 			if (steer.mag2() > 0.0f)
 			{
 				steer.set_mag(max_speed);
-				steer -= p->dp;
+				steer -= p.dp;
 				steer.limit(max_force);
 			}
 		}
@@ -75,10 +75,10 @@ namespace dukat
 			if (boid.predator)
 				continue;
 
-			auto diff = (p->pos - boid.p->pos).mag();
+			auto diff = (p.pos - boid.p.pos).mag();
 			if (diff > 0.0f && diff < neighbor_distance)
 			{
-				sum += boid.p->dp;
+				sum += boid.p.dp;
 				count++;
 			}
 		}
@@ -87,7 +87,7 @@ namespace dukat
 		{
 			sum /= static_cast<float>(count);
 			sum.set_mag(max_speed);
-			auto steer = sum - p->dp;
+			auto steer = sum - p.dp;
 			steer.limit(max_force);
 			return steer;
 		}
@@ -107,19 +107,19 @@ namespace dukat
 			if (boid.predator)
 				continue;
 
-			auto diff = (p->pos - boid.p->pos).mag();
+			auto diff = (p.pos - boid.p.pos).mag();
 			if (diff > 0.0f && diff < neighbor_distance)
 			{
-				sum += boid.p->pos;
+				sum += boid.p.pos;
 				count++;
 			}
 		}
 
 		if (count > 0)
 		{
-			auto steer = sum / static_cast<float>(count) - p->pos;
+			auto steer = sum / static_cast<float>(count) - p.pos;
 			steer.set_mag(max_speed);
-			steer -= p->dp;
+			steer -= p.dp;
 			steer.limit(max_force);
 			return steer;
 		}
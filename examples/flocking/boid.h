@@ -9,9 +9,10 @@ namespace dukat
 		float max_speed; // max speed
 		float max_force; // max steering force
 		bool predator;
-		Particle* p;
+		// Current state, drawn as a particle each frame.
+		Particle p;
 
-		Boid(Particle* p, bool predator = false);
+		Boid(const Particle& p, bool predator = false);
 		~Boid(void) { }
 
 		void update(const std::vector<Boid>& boids);
@@ -82,21 +82,20 @@ namespace dukat
 
 	void FlockingScene::add_boid(const Vector2& pos, bool predator)
 	{
-		auto p = game->get<ParticleManager>()->create_particle();
-		p->pos = pos;
+		Particle p;
+		p.pos = pos;
 		if (predator)
 		{
-			p->color = { 1.0f, 0.0f, 0.0f, randf(0.25f, 1.0f) };
+			p.color = { 1.0f, 0.0f, 0.0f, randf(0.25f, 1.0f) };
 		}
 		else
 		{
-			p->color = { 1.0f, 1.0f, 1.0f, randf(0.25f, 1.0f) };
+			p.color = { 1.0f, 1.0f, 1.0f, randf(0.25f, 1.0f) };
 		}
-		p->size = 4.0f;
-		p->dp = Vector2{ 1.0f, 0.0f };
-		p->dc = { 0.0f, 0.0f, 0.0f, 0.0f };
-		p->ttl = 1800.0f;
-		particle_layer->add(p);
+		p.size = 4.0f;
+		p.dp = Vector2{ 1.0f, 0.0f };
+		p.dc = { 0.0f, 0.0f, 0.0f, 0.0f };
+		p.ttl = 1.0f;
 		boids.push_back(Boid{ p, predator });
 	}
 
@@ -125,17 +124,27 @@ namespace dukat
 		
 		Scene2::update(delta);
 
-		// wrap around
-		std::for_each(boids.begin(), boids.end(), [](Boid& b) {
-			if (b.p->pos.x < 0.0f)
-				b.p->pos.x += window_width;
-			else if (b.p->pos.x > window_width)
-				b.p->pos.x -= window_width;
-			if (b.p->pos.y < 0.0f)
-				b.p->pos.y += window_height;
-			else if (b.p->pos.y > window_height)
-				b.p->pos.y -= window_height;
+		// move and wrap around
+		std::for_each(boids.begin(), boids.end(), [delta](Boid& b) {
+			b.p.pos += b.p.dp * delta;
+			if (b.p.pos.x < 0.0f)
+				b.p.pos.x += window_width;
+			else if (b.p.pos.x > window_width)
+				b.p.pos.x -= window_width;
+			if (b.p.pos.y < 0.0f)
+				b.p.pos.y += window_height;
+			else if (b.p.pos.y > window_height)
+				b.p.pos.y -= window_height;
 		});
+
+		// boids move themselves, so draw them as stationary particles for this frame only
+		particle_layer->clear();
+		for (const auto& b : boids)
+		{
+			auto p = b.p;
+			p.dp = Vector2{ 0.0f, 0.0f };
+			particle_layer->add(p);
+		}
 	}
 }
 
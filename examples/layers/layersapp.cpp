@@ -32,6 +32,8 @@ namespace dukat
 		});
 
 		auto bg_layer = game->get_renderer()->create_layer("background", 10.0f);
+		// background does not move, so bake its sprites once
+		bg_layer->set_static(true);
 
 		auto scene_mirror = game->get_renderer()->create_layer("scene_mirror", 15.0f);
 		scene_mirror->set_composite_program(game->get_shaders()->get_program("fx_default.vsh", "fx_mirror.fsh"));
@@ -93,7 +95,10 @@ namespace dukat
 				<< " VIR: " << cam->transform.dimension.x << "x" << cam->transform.dimension.y
 				<< " FPS: " << game->get_fps()
 				<< " MESH: " << dukat::perfc.avg(dukat::PerformanceCounter::MESHES)
-				<< " VERT: " << dukat::perfc.avg(dukat::PerformanceCounter::VERTICES) << std::endl;
+				<< " VERT: " << dukat::perfc.avg(dukat::PerformanceCounter::VERTICES)
+				<< " SPR: " << dukat::perfc.avg(dukat::PerformanceCounter::SPRITES)
+				<< " DRAW: " << dukat::perfc.avg(dukat::PerformanceCounter::DRAW_CALLS)
+				<< " SORT: " << dukat::perfc.avg(dukat::PerformanceCounter::SPRITE_SORT) << "us" << std::endl;
 			debug_text->set_text(ss.str());
 		}, true);
 
@@ -119,14 +124,13 @@ namespace dukat
 		barrel_sprite->z = barrel_sprite->p.y;
 
 		// spawn particles
-		auto pm = game->get<ParticleManager>();
-		auto p = pm->create_particle();
-		p->pos = Vector2{ randf(-4.0f, 4.0f), -randf(32.0f, 34.0f) };
-		p->ry = -32.0f;
-		p->dp = Vector2{ randf(-4.0f, 4.0f), -randf(12.0f, 16.0f) };
-		p->color = Color{ 1.0f, 1.0f, 1.0f, randf(0.75f, 1.0f) };
-		p->dc = Color{ 0.0f, 0.0f, 0.0f, -0.1f };
-		p->ttl = 1.0f;
+		Particle p;
+		p.pos = Vector2{ randf(-4.0f, 4.0f), -randf(32.0f, 34.0f) };
+		p.ry = -32.0f;
+		p.dp = Vector2{ randf(-4.0f, 4.0f), -randf(12.0f, 16.0f) };
+		p.color = Color{ 1.0f, 1.0f, 1.0f, randf(0.75f, 1.0f) };
+		p.dc = Color{ 0.0f, 0.0f, 0.0f, -0.1f };
+		p.ttl = 1.0f;
 		game->get_renderer()->get_layer("scene")->add(p);
 
 		Scene2::update(delta);
@@ -6,7 +6,7 @@
 
 namespace dukat
 {
-	SpritesScene::SpritesScene(Game2* game2) : Scene2(game2), particles_enabled(true)
+	SpritesScene::SpritesScene(Game2* game2) : Scene2(game2), particles_enabled(true), fountain(nullptr)
 	{
 		auto settings = game->get_settings();
 		// Set up default camera centered around origin
@@ -33,7 +33,9 @@ namespace dukat
 		std::stringstream ss;
 		ss << "Sprite Test" << std::endl
 			<< "<WASD> to move sprite" << std::endl
-			<< "<T>oggle particles" << std::endl;
+			<< "<T>oggle particles" << std::endl
+			<< "<B>enchmark mode" << std::endl
+			<< "<G>PU particle fountain" << std::endl;
 		info_text->set_text(ss.str());
 		info_layer->add(info_text.get());
 
@@ -59,7 +61,12 @@ namespace dukat
 				<< " VIR: " << cam->transform.dimension.x << "x" << cam->transform.dimension.y
 				<< " FPS: " << game->get_fps()
 				<< " MESH: " << dukat::perfc.avg(dukat::PerformanceCounter::MESHES)
-				<< " VERT: " << dukat::perfc.avg(dukat::PerformanceCounter::VERTICES) << std::endl;
+				<< " VERT: " << dukat::perfc.avg(dukat::PerformanceCounter::VERTICES) << std::endl
+				<< "SPR: " << dukat::perfc.avg(dukat::PerformanceCounter::SPRITES)
+				<< " PAR: " << dukat::perfc.avg(dukat::PerformanceCounter::PARTICLES)
+				<< " DRAW: " << dukat::perfc.avg(dukat::PerformanceCounter::DRAW_CALLS)
+				<< " PREP: " << dukat::perfc.avg(dukat::PerformanceCounter::SPRITE_PREPARE) << "us"
+				<< " SUBMIT: " << dukat::perfc.avg(dukat::PerformanceCounter::SPRITE_SUBMIT) << "us" << std::endl;
 			debug_text->set_text(ss.str());
 		}, true);
 
@@ -76,9 +83,74 @@ namespace dukat
 		case SDLK_t:
 			particles_enabled = !particles_enabled;
 			break;
+		case SDLK_b:
+			toggle_benchmark();
+			break;
+		case SDLK_g:
+			toggle_fountain();
+			break;
+		}
+	}
+
+	void SpritesScene::toggle_benchmark(void)
+	{
+		auto renderer = game->get_renderer();
+		if (!bench_sprites.empty())
+		{
+			for (auto i = 0; i < bench_layer_count; i++)
+			{
+				renderer->destroy_layer("bench" + std::to_string(i));
+			}
+			bench_sprites.clear();
+			bench_velocities.clear();
+			return;
+		}
+
+		// spread sprites over several layers so they can be prepared in parallel
+		auto texture = game->get_textures()->get("dukat.png");
+		const auto half_width = 0.5f * static_cast<float>(window_width);
+		const auto half_height = 0.5f * static_cast<float>(window_height);
+		for (auto i = 0; i < bench_layer_count; i++)
+		{
+			auto layer = renderer->create_layer("bench" + std::to_string(i), 16.0f + 0.1f * i);
+			for (auto j = 0; j < bench_sprite_count; j++)
+			{
+				auto s = std::make_unique<Sprite>(texture);
+				s->p = Vector2{ randf(-half_width, half_width), randf(-half_height, half_height) };
+				s->scale = 0.25f;
+				s->rot = randf(0.0f, two_pi);
+				s->z = static_cast<float>(j);
+				layer->add(s.get());
+				bench_sprites.push_back(std::move(s));
+				bench_velocities.push_back(Vector2{ randf(-20.0f, 20.0f), randf(-20.0f, 20.0f) });
+			}
 		}
 	}
 
+	void SpritesScene::toggle_fountain(void)
+	{
+		if (fountain != nullptr)
+		{
+			particle_layer->remove(fountain);
+			fountain = nullptr;
+			return;
+		}
+
+		auto emitter = std::make_unique<ParticleEmitter2>(game, fountain_capacity);
+		auto& params = emitter->params;
+		params.spread = Vector2{ 2.0f, 2.0f };
+		params.min_dp = Vector2{ -40.0f, -80.0f };
+		params.max_dp = Vector2{ 40.0f, -20.0f };
+		params.color = { 1.0f, 0.8f, 0.3f, 1.0f };
+		params.dc = { 0.0f, -0.2f, -0.1f, -0.25f };
+		params.min_size = 1.0f;
+		params.max_size = 3.0f;
+		params.min_ttl = 2.0f;
+		params.max_ttl = 4.0f;
+		params.rate = 40000.0f;
+		fountain = static_cast<ParticleEmitter2*>(particle_layer->add(std::move(emitter)));
+	}
+
 	void SpritesScene::update(float delta)
 	{
 		auto dev = game->get_devices()->active;
@@ -111,19 +183,35 @@ namespace dukat
 			audio_delay = 0.2f;
 		}
 
+		for (auto i = 0u; i < bench_sprites.size(); i++)
+		{
+			auto& s = bench_sprites[i];
+			auto& v = bench_velocities[i];
+			s->p += v * delta;
+			if (s->p.x < -half_width || s->p.x > half_width)
+				v.x = -v.x;
+			if (s->p.y < -half_height || s->p.y > half_height)
+				v.y = -v.y;
+		}
+
+		if (fountain != nullptr)
+		{
+			fountain->params.pos = sprite->p;
+		}
+
 		const auto pos_offset = 5.0f;
 		const auto vel_offset = 5.0f;
 
 		// Create a new particle
 		if (particles_enabled && (input.x != 0.0f || input.y != 0.0f))
 		{
-			auto p = game->get<ParticleManager>()->create_particle();
-			p->pos = sprite->p + Vector2{ randf(-pos_offset, pos_offset), randf(-pos_offset, pos_offset) }; 
-			p->color = { std::abs(input.x), std::abs(input.y), 1.0f, 1.0f };
-			p->size = randf(5.0f, 10.0f);
-			p->dp = input * -15.0f + Vector2{ randf(-vel_offset, vel_offset), randf(-vel_offset, vel_offset) }; 
-			p->dc = { 0.0f, 0.0f, 0.0f, -0.2f };
-			p->ttl = 5.0f;
+			Particle p;
+			p.pos = sprite->p + Vector2{ randf(-pos_offset, pos_offset), randf(-pos_offset, pos_offset) }; 
+			p.color = { std::abs(input.x), std::abs(input.y), 1.0f, 1.0f };
+			p.size = randf(5.0f, 10.0f);
+			p.dp = input * -15.0f + Vector2{ randf(-vel_offset, vel_offset), randf(-vel_offset, vel_offset) }; 
+			p.dc = { 0.0f, 0.0f, 0.0f, -0.2f };
+			p.ttl = 5.0f;
 			particle_layer->add(p);
 		}
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <dukat/dukat.h>
 
 namespace dukat
@@ -12,6 +13,11 @@ namespace dukat
 	private:
 		static constexpr int window_width = 400;
 		static constexpr int window_height = 300;
+		// Layers and sprites per layer used in benchmark mode.
+		static constexpr int bench_layer_count = 4;
+		static constexpr int bench_sprite_count = 5000;
+		// Capacity of the GPU particle fountain.
+		static constexpr int fountain_capacity = 200000;
 
 		std::unique_ptr<Sprite> bg_sprite;
 		std::unique_ptr<Sprite> sprite;
@@ -23,6 +29,14 @@ namespace dukat
 		Vector2 sprite_vel;
 		bool particles_enabled;
 		float audio_delay;
+		// Sprites drifting across the screen to stress sprite preparation.
+		std::vector<std::unique_ptr<Sprite>> bench_sprites;
+		std::vector<Vector2> bench_velocities;
+		// GPU-simulated particles following the sprite, owned by particle_layer.
+		ParticleEmitter2* fountain;
+
+		void toggle_benchmark(void);
+		void toggle_fountain(void);
 
 	public:
 		SpritesScene(Game2* game);
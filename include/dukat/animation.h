@@ -1,8 +1,12 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <typeindex>
 #include <vector>
 
+#include "animationpool.h"
+
 namespace dukat
 {
 	template <typename T>
@@ -30,92 +34,111 @@ namespace dukat
 		virtual bool is_done(void) const = 0;
 		virtual void start(void) = 0;
 		virtual void stop(void) = 0;
-		virtual void step(float delta) = 0;
+
+		// Identifies the pool that steps this animation.
+		virtual std::type_index get_pool_type(void) const = 0;
+		// Creates a pool for animations of this type.
+		virtual std::unique_ptr<AnimationPoolBase> create_pool(void) const = 0;
+		// Moves the animation into a pool of its type and starts it.
+		virtual void attach(AnimationPoolBase* pool) = 0;
+		// Called by the manager after the animation reached its last key.
+		virtual void complete(void) = 0;
 	};
 
+	// Animates an attribute along a sequence of keys. Once added to the
+	// AnimationManager, keys and state are kept in the pool for type T and
+	// this object only forwards to it.
 	template <typename T>
 	class ValueAnimation : public Animation
 	{
 	private:
-		// animation keys
-		std::vector<AnimationKey<T>> keys;
-		int next_key;
-		// time since animation was started
-		float time;
+		friend class AnimationPool<T>;
+
 		// target attribute
 		T* attribute;
-		// change to attribute per second
-		float value_delta;
+		// animation keys, until moved to the pool
+		std::vector<AnimationKey<T>> keys;
 		// if true will loop animation
 		bool loop;
 		// called when animation is done
 		std::function<void(void)> callback;
+		// pool stepping the animation, and index within it
+		AnimationPool<T>* pool;
+		int index;
+
+		bool is_attached(void) const { return index >= 0; }
 
 	public:
 		// Creates a new animation for the attribute provided.
-		ValueAnimation(T* attribute) : attribute(attribute), next_key(-1), loop(false) { }
+		ValueAnimation(T* attribute) : attribute(attribute), loop(false), pool(nullptr), index(-1) { }
 		// Creates a new animation with a single animation key specified by time and value.
 		ValueAnimation(T* attribute, float time, T value, bool loop = false)
-			: attribute(attribute), next_key(-1), loop(loop) { add_key({ time, value }); }
+			: attribute(attribute), loop(loop), pool(nullptr), index(-1) { add_key({ time, value }); }
 		~ValueAnimation(void) { }
 
 		void set_callback(const std::function<void(void)>& callback) { this->callback = callback; }
-		void set_loop(bool loop) { this->loop = loop; }
+		void set_loop(bool loop);
 		bool is_loop(void) const { return loop; }
-		bool is_running(void) const { return next_key > -1 && !is_done(); }
-		bool is_done(void) const { return (keys.begin() + next_key) == keys.end(); }
+		bool is_running(void) const { return is_attached() && pool->get_state(index) == AnimationPool<T>::Running; }
+		bool is_done(void) const { return is_attached() && pool->get_state(index) != AnimationPool<T>::Running; }
 
-		void add_key(const AnimationKey<T>& key) { keys.push_back(key); }
+		void add_key(const AnimationKey<T>& key);
 
 		void start(void);
 		void stop(void);
-		void step(float delta);
+
+		std::type_index get_pool_type(void) const { return std::type_index(typeid(T)); }
+		std::unique_ptr<AnimationPoolBase> create_pool(void) const { return std::make_unique<AnimationPool<T>>(); }
+		void attach(AnimationPoolBase* pool);
+		void complete(void);
 	};
 
+	template<typename T>
+	inline void ValueAnimation<T>::set_loop(bool loop)
+	{
+		this->loop = loop;
+		if (is_attached())
+			pool->set_loop(index, loop);
+	}
+
+	template<typename T>
+	inline void ValueAnimation<T>::add_key(const AnimationKey<T>& key)
+	{
+		if (is_attached())
+			pool->add_key(index, key);
+		else
+			keys.push_back(key);
+	}
+
 	template<typename T>
 	inline void ValueAnimation<T>::start(void)
 	{
-		time = 0.0f;
-		next_key = 0;
-		// compute delta used by continuous animations
-		auto next = keys.begin();
-		value_delta = (next->value - *attribute) / next->index;
+		// animations start once added to the manager
+		if (is_attached())
+			pool->start(index);
 	}
 
 	template<typename T>
 	inline void ValueAnimation<T>::stop(void)
 	{
-		next_key = keys.end() - keys.begin();
+		if (is_attached())
+			pool->stop(index);
 	}
 
 	template<typename T>
-	inline void ValueAnimation<T>::step(float delta)
+	inline void ValueAnimation<T>::attach(AnimationPoolBase* pool)
 	{
-		auto next = keys.begin() + next_key;
-		if (next->mode == AnimationKey<T>::Continuous)
-		{
-			*attribute += static_cast<T>(value_delta * delta);
-		}
-		// next animation key
-		if (time >= next->index)
-		{
-			*attribute = next->value;
-			next_key++;
-			++next;
-			// check if we've reached the last key
-			if (next == keys.end())
-			{
-				if (callback)
-					callback();
-				if (loop)
-					start(); // restart
-			}
-			else
-			{
-				// compute new delta for continuous animations
-				value_delta = (next->value - *attribute) / (next->index - time);
-			}
-		}
-		time += delta;
+		this->pool = static_cast<AnimationPool<T>*>(pool);
+		index = this->pool->add(this, attribute, keys, loop);
+		keys.clear();
+		keys.shrink_to_fit();
+	}
+
+	template<typename T>
+	inline void ValueAnimation<T>::complete(void)
+	{
+		// skip animations stopped by an earlier callback of the same update
+		if (callback && (!is_attached() || pool->get_state(index) != AnimationPool<T>::Stopped))
+			callback();
 	}
-}
\ No newline at end of file
+}
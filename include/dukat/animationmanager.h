@@ -1,27 +1,37 @@
 #pragma once
 
+#include <map>
 #include <memory>
-#include <list>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
 
 #include "animation.h"
 #include "manager.h"
 
 namespace dukat
 {
+	// Steps animations in pools grouped by value type. Completion callbacks
+	// are invoked in a batch once all pools have been stepped.
 	class AnimationManager : public Manager
 	{
 	private:
-		std::list<std::unique_ptr<Animation>> animations;
-		
+		std::map<std::type_index, std::unique_ptr<AnimationPoolBase>> pools;
+		std::unordered_map<Animation*, std::unique_ptr<Animation>> animations;
+		// Animations collected during update, reused between frames.
+		std::vector<Animation*> removed;
+		std::vector<Animation*> completed;
+
 	public:
 		AnimationManager(GameBase* game) : Manager(game) { }
 		~AnimationManager(void) { }
 		Animation* add(std::unique_ptr<Animation> animation);
+		// Stops an animation. It is released during the next update.
 		void cancel(Animation* animation);
 
 		void update(float delta);
 
-		// Clears all active animations.
-		void clear(void) { animations.clear(); }
+		// Stops all active animations.
+		void clear(void);
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dukat
+{
+	class Animation;
+	template <typename T> struct AnimationKey;
+	template <typename T> class ValueAnimation;
+
+	// Type-independent interface, so the manager can step pools of different value types.
+	class AnimationPoolBase
+	{
+	public:
+		AnimationPoolBase(void) { }
+		virtual ~AnimationPoolBase(void) { }
+
+		// Removes animations that finished or were stopped and collects them.
+		virtual void sweep(std::vector<Animation*>& removed) = 0;
+		// Advances all running animations and collects those that reached their last key.
+		virtual void step(float delta, std::vector<Animation*>& completed) = 0;
+		// Returns the number of animations in the pool.
+		virtual int size(void) const = 0;
+	};
+
+	// Steps all animations of one value type. Per-animation state is stored
+	// as separate arrays and the keys of all animations share contiguous
+	// storage, so a step runs tight loops over plain data instead of a
+	// virtual call per animation.
+	template <typename T>
+	class AnimationPool : public AnimationPoolBase
+	{
+	public:
+		enum State
+		{
+			Running, Finished, Stopped
+		};
+
+	private:
+		// Hot data, touched every step
+		std::vector<T*> targets;
+		// Change to the attribute per second; zero while approaching a discrete key.
+		std::vector<T> rates;
+		// Time since each animation was started.
+		std::vector<float> times;
+		// Time of the key each animation is approaching.
+		std::vector<float> key_due;
+
+		// Ranges into key storage
+		std::vector<int> first_keys, next_keys, end_keys;
+		std::vector<uint8_t> loops;
+		std::vector<uint8_t> states;
+		std::vector<ValueAnimation<T>*> owners;
+
+		// Key storage shared by all animations
+		std::vector<float> key_times;
+		std::vector<T> key_values;
+		std::vector<uint8_t> key_continuous;
+		// Keys no longer referenced by any animation.
+		int unused_keys;
+
+		// Flags and indices of animations that reached a key during the current step.
+		std::vector<uint8_t> due;
+		std::vector<int> reached;
+
+		// Starts approaching the key at next_keys[i] from the current attribute value.
+		void approach(int i, float time)
+		{
+			const auto k = next_keys[i];
+			key_due[i] = key_times[k];
+			rates[i] = key_continuous[k] ? (key_values[k] - *targets[i]) / (key_times[k] - time) : T{};
+		}
+		// Moves the keys of an animation to the end of key storage.
+		void relocate_keys(int i);
+		// Rebuilds key storage without unused keys.
+		void compact_keys(void);
+		void remove(int i);
+
+	public:
+		AnimationPool(void) : unused_keys(0) { }
+		~AnimationPool(void) { }
+
+		// Adds an animation and starts it. Returns its index in the pool.
+		int add(ValueAnimation<T>* owner, T* target, const std::vector<AnimationKey<T>>& keys, bool loop);
+		// Appends a key to an animation.
+		void add_key(int i, const AnimationKey<T>& key);
+		void start(int i);
+		void stop(int i);
+		void set_loop(int i, bool loop) { loops[i] = loop; }
+		State get_state(int i) const { return static_cast<State>(states[i]); }
+
+		void sweep(std::vector<Animation*>& removed);
+		void step(float delta, std::vector<Animation*>& completed);
+		int size(void) const { return static_cast<int>(targets.size()); }
+	};
+
+	template <typename T>
+	int AnimationPool<T>::add(ValueAnimation<T>* owner, T* target, const std::vector<AnimationKey<T>>& keys, bool loop)
+	{
+		const auto i = size();
+		const auto first = static_cast<int>(key_times.size());
+		for (const auto& key : keys)
+		{
+			key_times.push_back(key.index);
+			key_values.push_back(key.value);
+			key_continuous.push_back(key.mode == AnimationKey<T>::Continuous);
+		}
+		targets.push_back(target);
+		rates.push_back(T{});
+		times.push_back(0.0f);
+		key_due.push_back(std::numeric_limits<float>::max());
+		first_keys.push_back(first);
+		next_keys.push_back(first);
+		end_keys.push_back(static_cast<int>(key_times.size()));
+		loops.push_back(loop);
+		states.push_back(Running);
+		owners.push_back(owner);
+		start(i);
+		return i;
+	}
+
+	template <typename T>
+	void AnimationPool<T>::add_key(int i, const AnimationKey<T>& key)
+	{
+		if (end_keys[i] != static_cast<int>(key_times.size()))
+			relocate_keys(i);
+		key_times.push_back(key.index);
+		key_values.push_back(key.value);
+		key_continuous.push_back(key.mode == AnimationKey<T>::Continuous);
+		end_keys[i]++;
+	}
+
+	template <typename T>
+	void AnimationPool<T>::start(int i)
+	{
+		times[i] = 0.0f;
+		next_keys[i] = first_keys[i];
+		if (first_keys[i] == end_keys[i])
+		{
+			// nothing to animate
+			states[i] = Finished;
+			return;
+		}
+		states[i] = Running;
+		approach(i, 0.0f);
+	}
+
+	template <typename T>
+	void AnimationPool<T>::stop(int i)
+	{
+		states[i] = Stopped;
+		rates[i] = T{};
+		key_due[i] = std::numeric_limits<float>::max();
+	}
+
+	template <typename T>
+	void AnimationPool<T>::relocate_keys(int i)
+	{
+		const auto first = static_cast<int>(key_times.size());
+		for (auto k = first_keys[i]; k < end_keys[i]; k++)
+		{
+			key_times.push_back(key_times[k]);
+			key_values.push_back(key_values[k]);
+			key_continuous.push_back(key_continuous[k]);
+		}
+		unused_keys += end_keys[i] - first_keys[i];
+		next_keys[i] += first - first_keys[i];
+		end_keys[i] += first - first_keys[i];
+		first_keys[i] = first;
+	}
+
+	template <typename T>
+	void AnimationPool<T>::compact_keys(void)
+	{
+		std::vector<float> new_times;
+		std::vector<T> new_values;
+		std::vector<uint8_t> new_continuous;
+		new_times.reserve(key_times.size() - unused_keys);
+		new_values.reserve(key_times.size() - unused_keys);
+		new_continuous.reserve(key_times.size() - unused_keys);
+		for (auto i = 0; i < size(); i++)
+		{
+			const auto first = static_cast<int>(new_times.size());
+			new_times.insert(new_times.end(), key_times.begin() + first_keys[i], key_times.begin() + end_keys[i]);
+			new_values.insert(new_values.end(), key_values.begin() + first_keys[i], key_values.begin() + end_keys[i]);
+			new_continuous.insert(new_continuous.end(), key_continuous.begin() + first_keys[i], key_continuous.begin() + end_keys[i]);
+			next_keys[i] += first - first_keys[i];
+			end_keys[i] += first - first_keys[i];
+			first_keys[i] = first;
+		}
+		key_times.swap(new_times);
+		key_values.swap(new_values);
+		key_continuous.swap(new_continuous);
+		unused_keys = 0;
+	}
+
+	template <typename T>
+	void AnimationPool<T>::remove(int i)
+	{
+		unused_keys += end_keys[i] - first_keys[i];
+		// fill the gap with the last animation
+		const auto last = size() - 1;
+		if (i != last)
+		{
+			targets[i] = targets[last];
+			rates[i] = rates[last];
+			times[i] = times[last];
+			key_due[i] = key_due[last];
+			first_keys[i] = first_keys[last];
+			next_keys[i] = next_keys[last];
+			end_keys[i] = end_keys[last];
+			loops[i] = loops[last];
+			states[i] = states[last];
+			owners[i] = owners[last];
+			owners[i]->index = i;
+		}
+		targets.pop_back();
+		rates.pop_back();
+		times.pop_back();
+		key_due.pop_back();
+		first_keys.pop_back();
+		next_keys.pop_back();
+		end_keys.pop_back();
+		loops.pop_back();
+		states.pop_back();
+		owners.pop_back();
+	}
+
+	template <typename T>
+	void AnimationPool<T>::sweep(std::vector<Animation*>& removed)
+	{
+		for (auto i = size() - 1; i >= 0; i--)
+		{
+			if (states[i] != Running)
+			{
+				removed.push_back(owners[i]);
+				owners[i]->index = -1;
+				remove(i);
+			}
+		}
+		if (unused_keys > static_cast<int>(key_times.size()) / 2)
+			compact_keys();
+	}
+
+	template <typename T>
+	void AnimationPool<T>::step(float delta, std::vector<Animation*>& completed)
+	{
+		const auto n = size();
+		for (auto i = 0; i < n; i++)
+		{
+			*targets[i] += rates[i] * delta;
+		}
+
+		due.resize(n);
+		for (auto i = 0; i < n; i++)
+		{
+			due[i] = times[i] >= key_due[i];
+		}
+
+		reached.clear();
+		for (auto i = 0; i < n; i++)
+		{
+			if (due[i])
+				reached.push_back(i);
+		}
+
+		for (auto i : reached)
+		{
+			*targets[i] = key_values[next_keys[i]];
+			if (++next_keys[i] < end_keys[i])
+			{
+				approach(i, times[i]);
+				continue;
+			}
+
+			completed.push_back(owners[i]);
+			if (loops[i])
+			{
+				start(i);
+			}
+			else
+			{
+				stop(i);
+				states[i] = Finished;
+			}
+		}
+
+		for (auto i = 0; i < n; i++)
+		{
+			times[i] += delta;
+		}
+	}
+}
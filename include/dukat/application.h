@@ -49,6 +49,8 @@ namespace dukat
 		int run(void);
 
 		void toggle_pause(void) { paused = !paused; }
+		// Starts recording a profile, or saves the one being recorded.
+		void toggle_profiler(void);
 		bool is_done(void) const { return done; }
 		void set_done(bool done) { this->done = done; }
 		int get_fps(void) const { return last_fps; }
@@ -1,30 +1,107 @@
 #pragma once
 
+#include <functional>
 #include <list>
 #include <memory>
 #include <unordered_set>
 
 #include "game2.h"
 #include "manager.h"
+#include "objectpool.h"
 #include "quadtree.h"
 
 namespace dukat
 {
 	class DebugEffect2;
+	class WorkerPool;
 
 	class CollisionManager2 : public Manager
 	{
 	public:	
+		// Algorithm used to determine potential collisions.
+		enum BroadPhase
+		{
+			QUAD_TREE,			// fixed-depth quad tree
+			SWEEP_AND_PRUNE		// bodies sorted along the x-axis
+		};
+
+		// Index used to mark the end of a contact list.
+		static constexpr uint32_t no_contact = 0xffffffff;
+
 		struct Body
 		{
-			const uint16_t id;
+			// Shape tested during the narrow phase.
+			enum Shape
+			{
+				BOX,			// axis-aligned box matching bb
+				ORIENTED_BOX,	// rotated box centered on bb
+				CIRCLE			// circle centered on bb
+			};
+
+			const uint32_t id;
 			bool dynamic;	// dynamic bodies can be moved as part of collision resolution
 			bool solid;		// if true, will cause this body to take part in collision resolution
 			bool active;	// if false, will cause this body to be ignored by collision manager
-			AABB2 bb;
+			bool fast;		// if true, will be tested along the path moved since the last update
+			uint32_t category;	// collision layers this body belongs to
+			uint32_t mask;		// collision layers this body collides with
+			AABB2 bb;		// encloses the shape and is used during the broad phase
 			Messenger* owner;
+			Shape shape;
+			Vector2 extent;	// half size of an oriented box along its axes
+			Vector2 axis;	// x-axis of an oriented box
+			float radius;	// radius of a circle
 
-			Body(uint16_t id) : id(id), dynamic(true), solid(true), active(true), owner(nullptr) { }
+			Body(uint32_t id) : id(id), dynamic(true), solid(true), active(true), fast(false), 
+				category(0x1), mask(0xffffffff), owner(nullptr), 
+				shape(BOX), axis(1.0f, 0.0f), radius(0.0f),
+				node(nullptr), node_dynamic(false), first_contact(no_contact), contact_degree(0), still_frames(0), asleep(false), 
+				destroying(false), index(0), sweep_index(0) { }
+
+			// Sets shape to an axis-aligned box.
+			void set_box(const AABB2& box) { shape = BOX; bb = box; }
+			// Sets shape to a box rotated by angle (in radians) and updates bb to enclose it.
+			void set_oriented_box(const Vector2& center, const Vector2& extent, float angle);
+			// Sets shape to a circle and updates bb to enclose it.
+			void set_circle(const Vector2& center, float radius);
+			// Checks if the shape of this body contains a point.
+			bool contains(const Vector2& p) const;
+			// Returns true if this body has not moved for a while and is skipped during updates.
+			bool is_asleep(void) const { return asleep; }
+
+			// Returns the area covered by this body since the last update.
+			AABB2 swept_bb(void) const
+			{
+				if (!fast || last_bb.empty())
+					return bb;
+				AABB2 res(bb);
+				res.add(last_bb);
+				return res;
+			}
+			// Fast bodies are partitioned by the area they swept.
+			friend AABB2 quadtree_bounds(const Body* body) { return body->swept_bb(); }
+
+		private:
+			friend class CollisionManager2;
+			// Tree node this body is currently stored in.
+			QuadTree<Body>* node;
+			// Value of dynamic flag at the time this body was inserted into the tree.
+			bool node_dynamic;
+			// Head of the list of contacts this body is part of.
+			uint32_t first_contact;
+			// Number of contacts this body is part of.
+			int contact_degree;
+			// Bounding box at the end of the last update.
+			AABB2 last_bb;
+			// Number of updates bb has not changed.
+			int still_frames;
+			bool asleep;
+			// Set while destroy_body notifies other bodies, whose handlers may destroy this body again.
+			bool destroying;
+			// Position in the list of bodies.
+			uint32_t index;
+			// Position in the sweep list as of the last update.
+			uint32_t sweep_index;
 		};
 
 		struct Contact
@@ -33,30 +110,167 @@ namespace dukat
 			Body* body2;
 			Collision collision;
 			uint8_t generation;
+			float toi;	// time of impact as fraction of the last frame; 1 if not swept
+
+			Contact(void) : body1(nullptr), body2(nullptr), generation(0), toi(1.0f), next{ no_contact, no_contact }, prev{ no_contact, no_contact } { }
+
+		private:
+			friend class CollisionManager2;
+			// Links to neighboring contacts of body1 (index 0) and body2 (index 1).
+			uint32_t next[2];
+			uint32_t prev[2];
+		};
+
+		// Result of a ray query.
+		struct RayHit
+		{
+			Body* body;	// closest body hit by the ray, or nullptr
+			float t;	// distance to hit along the ray, in multiples of ray.dir
 		};
 
 	private:
+		// Cached body extents used by sweep and prune.
+		struct SweepEntry
+		{
+			Vector2 min;
+			Vector2 max;
+			Body* body;
+			bool active;
+			bool awake;		// dynamic and not asleep
+		};
+
+		// Intersection found during the narrow phase.
+		struct NarrowResult
+		{
+			Body* body1;
+			Body* body2;
+			uint32_t contact;	// existing contact between the two bodies, or no_contact
+			Collision collision;
+			float toi;
+		};
+
+		// Output of a single narrow phase job.
+		struct NarrowChunk
+		{
+			std::vector<NarrowResult> results;
+			int checks;
+		};
+
+		// Collision event raised during an update. Events are delivered once all
+		// contacts have been processed, so handlers may destroy bodies.
+		struct PendingEvent
+		{
+			Body* body;		// body whose owner receives the event, or nullptr if dropped
+			Event event;
+			Body* other;	// body collided with
+			Contact contact;	// copy of the new contact for CollisionBegin
+			Vector2 shift;	// direction of resolution for CollisionResolve
+		};
+
+		// Minimum number of candidate pairs tested by a single narrow phase job.
+		static constexpr int min_chunk_size = 256;
+		// Minimum number of queries run by a single job.
+		static constexpr int min_query_chunk = 32;
+
+		BroadPhase broad_phase;
+		// Number of updates a body's bounding box must remain unchanged before it goes to sleep.
+		int sleep_frames;
+		// If true, tree nodes without bodies in matching layers are skipped.
+		bool mask_pruning;
+		WorkerPool* worker_pool;
 		Vector2 world_origin;
 		float world_size;
 		int world_depth;
 		// Used to determine which collisions have been resolved.
 		uint8_t generation;
 
-		std::unique_ptr<QuadTree<Body>> tree;
-		std::list<std::unique_ptr<Body>> bodies;
-		std::unordered_map<uint32_t, Contact> contacts;
+		// Static bodies are kept in a separate tree, since they rarely move.
+		std::unique_ptr<QuadTree<Body>> static_tree;
+		std::unique_ptr<QuadTree<Body>> dynamic_tree;
+		// Bodies ordered by min.x as of the last update.
+		std::vector<SweepEntry> sweep;
+		// Candidate pairs emitted by the broad phase.
+		std::vector<std::pair<Body*, Body*>> pairs;
+		// Scratch buffer for tree queries.
+		std::vector<Body*> candidates;
+		// Per-job narrow phase results.
+		std::vector<NarrowChunk> chunks;
+		// Bodies are allocated from a pool, so their addresses remain stable,
+		// and listed densely for iteration in no particular order.
+		ObjectPool<Body> body_pool;
+		std::vector<Body*> bodies;
+		// Contacts are stored densely; unused slots have body1 set to nullptr
+		// and are tracked in free_contacts for reuse.
+		std::vector<Contact> contacts;
+		std::vector<uint32_t> free_contacts;
+		// Events raised during the current update.
+		std::vector<PendingEvent> events;
 
 		friend class DebugEffect2;
 
-		// (Re)creates the quad tree.
+		// (Re)creates the quad trees.
 		void create_tree(void);
+		// Moves a body to the tree node that matches its current bounding box.
+		void update_node(Body* body);
+		// Removes a body from the tree node it is stored in.
+		void remove_node(Body* body);
 		// Collect all entities which are at equal or higher level in the tree as a given body.
-		void find_collisions(const QuadTree<Body>& t, Body* body, std::vector<Body*>& res) const;
+		// Stops at nodes without any entities in layers matching filter.
+		void find_collisions(const QuadTree<Body>& t, Body* body, std::vector<Body*>& res, uint32_t filter = 0xffffffff) const;
+		// Collects pairs of potentially colliding bodies using the quad trees.
+		void update_tree(void);
+		// Sorts sweep entries and collects overlapping pairs.
+		void update_sweep(void);
+		// Tests candidate pairs for intersection, spread across the worker pool.
+		void test_pairs(void);
+		// Tests a range of candidate pairs and stores intersections in a chunk.
+		void test_pairs(int first, int last, NarrowChunk& chunk) const;
+		// Creates or updates contacts from narrow phase results in a deterministic order.
+		void merge_contacts(void);
+		// Sweeps two bodies along their motion since the last update. Returns the
+		// time of impact as fraction of the frame, or no_intersection.
+		float time_of_impact(const Body* b1, const Body* b2) const;
+		// Runs fn(i) for each query of a batch, spread across the worker pool.
+		template<typename F>
+		void run_queries(int count, const F& fn) const;
+		// Calls fn(body) for each active body that may be contained in regions for which
+		// pred(min, max) returns true, and whose category matches mask.
+		template<typename P, typename F>
+		void visit_bodies(uint32_t mask, const P& pred, const F& fn) const;
+		// Single query implementations.
+		int query_area(const AABB2& box, uint32_t mask, Body** res, int max_results) const;
+		RayHit query_ray(const Ray2& ray, float far, uint32_t mask) const;
+		int query_nearest(const Vector2& p, int k, uint32_t mask, Body** res) const;
+
+		// Checks if a body is neither moving nor being tested for collisions.
+		static bool is_resting(const Body* b) { return b->active && (b->asleep || !b->dynamic); }
+		// Checks if the layers of two bodies allow them to collide.
+		static bool can_collide(const Body* b1, const Body* b2) { return (b1->category & b2->mask) != 0 && (b2->category & b1->mask) != 0; }
+		// Tests two bodies for intersection based on their shapes.
+		bool intersect(const Body* b1, const Body* b2, Collision& collision) const;
+		// Fills in a collision that moves b1 back to the point where it touched b2.
+		// Returns false if the bodies only grazed each other.
+		bool swept_collision(const Body* b1, const Body* b2, float toi, Collision& collision) const;
 		// Attempts to resolve active collisions and notifies at the end of collisions.
 		void resolve_collisions(void);
+		// Puts bodies to sleep that have not moved, and wakes up bodies that have.
+		void update_sleep(void);
+		// Wakes up a sleeping body that was touched during the narrow phase.
+		void wake_touched(Body* body);
+		// Triggers a collision event on the owner of its body.
+		void trigger_event(const PendingEvent& e) const;
+		// Delivers the events raised during this update.
+		void dispatch_events(void);
 
-		// Generate a hash for a contact between two bodies.
-		inline uint32_t hash(Body* b1, Body* b2) const { return 65536u * static_cast<uint32_t>(std::min(b1->id, b2->id)) + static_cast<uint32_t>(std::max(b1->id, b2->id)); }
+		// Returns the index of the contact between two bodies, or no_contact. Walks
+		// the contact list of the body with fewer contacts, so cost is O(degree).
+		uint32_t find_contact(const Body* b1, const Body* b2) const;
+		// Stores a new contact and links it to both bodies. Returns its index.
+		uint32_t add_contact(Body* b1, Body* b2);
+		// Unlinks a contact from both bodies and releases its slot.
+		void remove_contact(uint32_t index);
+		// Returns the slot (0 or 1) of a body within a contact.
+		inline int contact_slot(const Contact& c, const Body* b) const { return c.body1 == b ? 0 : 1; }
 
 	public:
 		CollisionManager2(GameBase* game);
@@ -69,20 +283,69 @@ namespace dukat
 		// Sets the depth of the world collision tree. 
 		void set_world_depth(int world_depth) { this->world_depth = world_depth; create_tree(); }
 
+		// Selects the broad phase algorithm (default QUAD_TREE).
+		void set_broad_phase(BroadPhase broad_phase);
+		BroadPhase get_broad_phase(void) const { return broad_phase; }
+		// Enables skipping of quad tree nodes that contain no bodies in layers matching a body's mask.
+		void set_mask_pruning(bool mask_pruning);
+		bool is_mask_pruning(void) const { return mask_pruning; }
+		// Sets the pool used for the narrow phase. If nullptr, all pairs are tested on the calling thread.
+		void set_worker_pool(WorkerPool* worker_pool) { this->worker_pool = worker_pool; }
+
+		// Sets the number of updates a body must rest before it goes to sleep. 0 disables sleeping.
+		void set_sleep_frames(int sleep_frames) { this->sleep_frames = sleep_frames; }
+		int get_sleep_frames(void) const { return sleep_frames; }
+
 		Body* create_body(bool dynamic = true);
+		// Releases a body after notifying the owners of bodies it is in contact with. Their
+		// handlers may destroy further bodies, including this one.
 		void destroy_body(Body* body);
+		// Wakes up a sleeping body. Bodies are woken automatically when they move or are
+		// touched by an awake body, but not when other properties such as shape or mask change.
+		void wake(Body* body);
 
 		// Returns the number of collision bodies.
 		int body_count(void) const { return static_cast<int>(bodies.size()); }
 		// Returns the number of contacts.
-		int contact_count(void) const { return static_cast<int>(contacts.size()); }
+		int contact_count(void) const { return static_cast<int>(contacts.size() - free_contacts.size()); }
+		// Returns the number of contacts of a given body.
+		int contact_count(const Body* b) const { return b->contact_degree; }
 		// Returns true if there exists a contact between two bodies.
-		bool has_contact(Body* b1, Body* b2) const { return contacts.count(hash(b1, b2)) > 0; }
-		// Returns all contacts for a given body.
-		std::list<Contact*> get_contacts(Body* b) const;
+		bool has_contact(const Body* b1, const Body* b2) const { return find_contact(b1, b2) != no_contact; }
+		// Calls fn(Contact&) for each contact of a given body without allocating.
+		// Contacts must not be created or destroyed from within fn.
+		template<typename F>
+		void for_each_contact(const Body* b, F fn);
+		// Returns all contacts for a given body. Pointers are valid until the next update.
+		std::list<Contact*> get_contacts(Body* b);
 		// Returns all bodies at point p.
 		std::list<Body*> get_bodies(const Vector2& p) const;
 
+		// Batched queries. These reflect body positions as of the last update, only
+		// return bodies with a category matching mask, and write into buffers provided
+		// by the caller without allocating. Large batches are spread across the worker pool.
+
+		// Collects up to max_results bodies overlapping each box. Results for box i are
+		// stored starting at res[i * max_results], their number in counts[i].
+		void query_area(const AABB2* boxes, int count, uint32_t mask, Body** res, int max_results, int* counts) const;
+		// Stores the closest bounding box hit by each ray within [0, far] in hits[i].
+		void query_ray(const Ray2* rays, int count, float far, uint32_t mask, RayHit* hits) const;
+		// Collects up to k bodies closest to each point, ordered by distance to their bounding box.
+		// Results for point i are stored starting at res[i * k], their number in counts[i].
+		void query_nearest(const Vector2* points, int count, int k, uint32_t mask, Body** res, int* counts) const;
+
 		void update(float delta);
 	};
+
+	template<typename F>
+	void CollisionManager2::for_each_contact(const Body* b, F fn)
+	{
+		auto index = b->first_contact;
+		while (index != no_contact)
+		{
+			auto& c = contacts[index];
+			index = c.next[contact_slot(c, b)];
+			fn(c);
+		}
+	}
 }
\ No newline at end of file
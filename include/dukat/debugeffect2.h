@@ -1,5 +1,6 @@
 #pragma once
 
+#include "collisionmanager2.h"
 #include "effect2.h"
 #include "game2.h"
 
@@ -25,6 +26,11 @@ namespace dukat
 		std::unique_ptr<MeshData> mesh;
 		Flags flags;
 
+		// Renders outline of all nodes in a collision tree.
+		void render_tree(QuadTree<CollisionManager2::Body>* tree, const AABB2& world_bb, const Color& color) const;
+		// Renders the outline of a collision body's shape.
+		void render_body(const CollisionManager2::Body* body, const Color& color) const;
+
 	public:
 		DebugEffect2(Game2* game, float scale);
 		~DebugEffect2(void);
@@ -7,6 +7,7 @@
 
 // Engine
 #include "component.h"
+#include "eventqueue.h"
 #include "game2.h"
 #include "game3.h"
 #include "gamebase.h"
@@ -66,15 +67,19 @@
 // System
 #include "animation.h"
 #include "animationmanager.h"
+#include "animationpool.h"
 #include "application.h"
 #include "assetloader.h"
 #include "bytestream.h"
 #include "log.h"
+#include "objectpool.h"
 #include "perfcounter.h"
+#include "profiler.h"
 #include "settings.h"
 #include "sysutil.h"
 #include "timermanager.h"
 #include "window.h"
+#include "workerpool.h"
 
 // Util
 #ifndef __ANDROID__
@@ -89,6 +94,7 @@
 #include "ms3dmodel.h"
 #include "octreenode.h"
 #endif
+#include "radixsort.h"
 #include "shape.h"
 #include "textureutil.h"
 #ifndef __ANDROID__
@@ -129,7 +135,9 @@
 #include "orbitallight.h"
 #include "orbitcamera3.h"
 #include "particle.h"
+#include "particleemitter2.h"
 #include "particlemanager.h"
+#include "particlestore.h"
 #include "renderer.h"
 #include "renderer2.h"
 #include "renderer3.h"
@@ -137,10 +145,14 @@
 #include "shadercache.h"
 #include "shaderprogram.h"
 #include "sprite.h"
+#include "spritechunkcache.h"
+#include "spritegrid.h"
+#include "streambuffer.h"
 #include "surface.h"
 #include "textmeshbuilder.h"
 #include "textmeshinstance.h"
 #include "texture.h"
+#include "textureatlas.h"
 #include "texturecache.h"
 #include "vertextypes2.h"
 #include "vertextypes3.h"
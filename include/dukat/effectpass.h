@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "buffers.h"
 #include "renderer.h"
 
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "recipient.h"
+
+namespace dukat
+{
+	class Messenger;
+
+	// Collects messages from messengers in deferred mode and delivers them
+	// in one batch per frame, grouped by event type and messenger. Messengers
+	// are ordered by the id they receive when they join the queue, so the
+	// delivery order only depends on the order of calls, never on where
+	// objects happen to be allocated. Messages are kept in a fixed-size ring
+	// buffer that is allocated up front; when it is full, new messages are
+	// dropped and counted.
+	class EventQueue
+	{
+	public:
+		// Number of bytes available to copy parameters into the queue.
+		static constexpr std::size_t max_payload = 64;
+
+	private:
+		struct Entry
+		{
+			Messenger* target;
+			// Queue id of the target, used for ordering.
+			uint32_t target_id;
+			Message message;
+			// Position in the order messages were queued.
+			uint32_t sequence;
+			// Sizes of parameters copied into payload, param2 following param1.
+			uint8_t param1_size, param2_size;
+			alignas(8) uint8_t payload[max_payload];
+		};
+
+		std::vector<Entry> entries;
+		// Entry indices in delivery order, reused for every flush.
+		std::vector<int> order;
+		// Index of the oldest queued entry and number of queued entries.
+		int head, count;
+		uint32_t sequence;
+		// Last id handed out to a messenger.
+		uint32_t last_messenger_id;
+		int dropped;
+		// Dropped messages already reported.
+		int reported;
+
+	public:
+		EventQueue(int capacity);
+		~EventQueue(void) { }
+		EventQueue(const EventQueue&) = delete;
+		EventQueue& operator=(const EventQueue&) = delete;
+
+		// Queues a message for a messenger. Parameters with a size other than
+		// zero are copied and may point to temporaries; together they must
+		// not exceed max_payload. Returns false if the message was dropped.
+		bool push(Messenger* target, const Message& message, std::size_t param1_size = 0, std::size_t param2_size = 0);
+		// Delivers all messages queued before this call. Messages queued
+		// while delivering are kept for the next flush; until then they share
+		// the capacity with the batch being delivered.
+		void flush(void);
+		// Discards queued messages for a messenger that is going away.
+		void cancel(Messenger* target);
+		// Delivers queued messages that pass param1 without copying it right
+		// away and removes them from the queue, so they never refer to an
+		// object that is released before the next flush.
+		void dispatch_param(const void* param1);
+		// Returns a new id for a messenger that joins the queue.
+		uint32_t register_messenger(void) { return ++last_messenger_id; }
+
+		int size(void) const { return count; }
+		int get_capacity(void) const { return static_cast<int>(entries.size()); }
+		// Returns the number of messages dropped since creation.
+		int get_dropped(void) const { return dropped; }
+	};
+}
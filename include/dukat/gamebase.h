@@ -3,12 +3,14 @@
 #include <memory>
 #include <stack>
 #include <typeindex>
+#include <unordered_map>
 
 #ifndef __ANDROID__
 #include "audiocache.h"
 #endif
 #include "animationmanager.h"
 #include "application.h"
+#include "eventqueue.h"
 #include "meshcache.h"
 #include "messenger.h"
 #include "textmeshinstance.h"
@@ -17,6 +19,7 @@
 #include "texturecache.h"
 #include "timermanager.h"
 #include "uimanager.h"
+#include "workerpool.h"
 
 namespace dukat
 {
@@ -34,6 +37,10 @@ namespace dukat
 		std::unique_ptr<ShaderCache> shader_cache;
 		std::unique_ptr<TextureCache> texture_cache;
 		std::unique_ptr<MeshCache> mesh_cache;
+		// Threads shared by managers to split up per-frame work.
+		std::unique_ptr<WorkerPool> worker_pool;
+		// Events of messengers in deferred mode, flushed after managers have updated.
+		std::unique_ptr<EventQueue> event_queue;
 		std::map<std::type_index, std::unique_ptr<Manager>> managers;
 		std::unordered_map<std::string, std::unique_ptr<Scene>> scenes;
 		std::stack<Scene*> scene_stack;
@@ -81,6 +88,8 @@ namespace dukat
 		ShaderCache* get_shaders(void) const { return shader_cache.get(); }
 		TextureCache* get_textures(void) const { return texture_cache.get(); }
 		MeshCache* get_meshes(void) const { return mesh_cache.get(); }
+		WorkerPool* get_worker_pool(void) const { return worker_pool.get(); }
+		EventQueue* get_event_queue(void) const { return event_queue.get(); }
 	};
 
 	// Define template methods here:
@@ -1,11 +1,14 @@
 #pragma once
 
-#include <unordered_map>
-#include <set>
+#include <array>
+#include <cstdint>
+#include <vector>
 #include "recipient.h"
 
 namespace dukat
 {
+	class EventQueue;
+
 	struct Events
 	{
 		// Range marker - does not trigger
@@ -34,9 +37,11 @@ namespace dukat
 		static constexpr Event ParentChanged = 16;
 		static constexpr Event TransformChanged = 17;
 		static constexpr Event VisibilityChanged = 18;
+		// Collision events that refer to a body being destroyed are delivered
+		// immediately, even in deferred mode.
 		// Marks begin of a collision.
 		// param1: Body* that entity collided with.
-		// param2: Contact* contact of this collision.
+		// param2: Contact* copy of the contact of this collision.
 		static constexpr Event CollisionBegin = 20;
 		// Marks end of a collision.
 		// param1: Body* that entity collided with.
@@ -49,19 +54,40 @@ namespace dukat
 		static constexpr Event Any = 64;
 	};
 
-	// Messenging class
+	// Messenging class. Subscribers are kept in one flat list per event, so
+	// triggering an event is a single lookup followed by a linear scan.
+	// Recipients may subscribe or unsubscribe while an event is dispatched:
+	// new recipients only receive later events, and removed ones are cleared
+	// in place and compacted once the outermost dispatch has finished.
+	// In deferred mode, triggered events are queued and delivered when the
+	// queue is flushed instead.
 	class Messenger
 	{
 	private:
-		// Map of subscribers, indexed by event type
-		std::unordered_map<Event, std::set<Recipient*>> subscriptions;
+		// Subscribers, indexed by event type
+		std::array<std::vector<Recipient*>, Events::Any> subscriptions;
+		// Number of trigger calls in progress.
+		int dispatch_depth;
+		// Set if recipients were removed during dispatch.
+		bool needs_compaction;
+		// Queue for deferred events, or nullptr to deliver immediately.
+		EventQueue* queue;
+		// Id assigned by the queue, used to order deferred events.
+		uint32_t queue_id;
+
+		// Removes cleared entries from all subscriber lists.
+		void compact(void);
 
 	public:
-		Messenger(void) { }
-		virtual ~Messenger(void) { }
+		Messenger(void) : dispatch_depth(0), needs_compaction(false), queue(nullptr), queue_id(0u) { }
+		virtual ~Messenger(void);
 
-		// Triggers an event for all recievers subscribed to this entity.
-		void trigger(const Message& message);
+		// Triggers an event for all recievers subscribed to this entity. In
+		// deferred mode, parameters have to stay valid until the queue is
+		// flushed, unless their size is given to have them copied.
+		void trigger(const Message& message, std::size_t param1_size = 0, std::size_t param2_size = 0);
+		// Delivers an event to all receivers right away, even in deferred mode.
+		void dispatch(const Message& message);
 		// Subscribes to an event on this entity.
 		void subscribe(Event ev, Recipient* recipient);
 		// Subscribes to all events on this entity.
@@ -70,5 +96,12 @@ namespace dukat
 		void unsubscribe(Event ev, Recipient* recipient);
 		// Unsubscribes from all events this recipient was registered for.
 		void unsubscribe_all(Recipient* recipient);
+
+		// Enables deferred mode if queue is not nullptr. The queue has to
+		// outlive this messenger. Events still pending in a previous queue
+		// are discarded.
+		void set_event_queue(EventQueue* queue);
+		EventQueue* get_event_queue(void) const { return queue; }
+		uint32_t get_queue_id(void) const { return queue_id; }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dukat
+{
+	// Allocates objects from fixed-size chunks of contiguous memory. Objects
+	// never move once created, so pointers remain valid until they are
+	// destroyed, and both create and destroy run in constant time.
+	template<class T, int chunk_size = 256>
+	class ObjectPool
+	{
+	private:
+		struct Slot
+		{
+			// Must remain the first member, so objects can be mapped back to their slot.
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+			bool used;
+		};
+
+		std::vector<std::unique_ptr<Slot[]>> chunks;
+		// Unused slots, most recently released last.
+		std::vector<Slot*> free_slots;
+		int live;
+
+		void add_chunk(void)
+		{
+			chunks.push_back(std::make_unique<Slot[]>(chunk_size));
+			auto chunk = chunks.back().get();
+			// hand out slots in memory order
+			for (auto i = chunk_size - 1; i >= 0; i--)
+			{
+				chunk[i].used = false;
+				free_slots.push_back(&chunk[i]);
+			}
+		}
+
+	public:
+		ObjectPool(void) : live(0) { }
+		~ObjectPool(void) { clear(); }
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		// Constructs a new object in an unused slot.
+		template<typename... Args>
+		T* create(Args&&... args)
+		{
+			if (free_slots.empty())
+				add_chunk();
+			auto slot = free_slots.back();
+			auto obj = new (&slot->storage) T(std::forward<Args>(args)...);
+			free_slots.pop_back();
+			slot->used = true;
+			live++;
+			return obj;
+		}
+
+		// Destroys an object created by this pool and releases its slot.
+		void destroy(T* obj)
+		{
+			auto slot = reinterpret_cast<Slot*>(obj);
+			obj->~T();
+			slot->used = false;
+			free_slots.push_back(slot);
+			live--;
+		}
+
+		// Destroys all objects. Memory is kept for reuse.
+		void clear(void)
+		{
+			free_slots.clear();
+			for (auto& chunk : chunks)
+			{
+				for (auto i = 0; i < chunk_size; i++)
+				{
+					if (chunk[i].used)
+						reinterpret_cast<T*>(&chunk[i].storage)->~T();
+					chunk[i].used = false;
+				}
+			}
+			for (auto it = chunks.rbegin(); it != chunks.rend(); ++it)
+			{
+				for (auto i = chunk_size - 1; i >= 0; i--)
+					free_slots.push_back(&(*it)[i]);
+			}
+			live = 0;
+		}
+
+		// Returns true if the slot of an object created by this pool is in use.
+		bool is_live(const T* obj) const { return reinterpret_cast<const Slot*>(obj)->used; }
+		// Returns the number of live objects.
+		int size(void) const { return live; }
+		// Returns the number of objects that fit into allocated chunks.
+		int capacity(void) const { return static_cast<int>(chunks.size()) * chunk_size; }
+	};
+}
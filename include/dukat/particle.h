@@ -5,6 +5,7 @@
 
 namespace dukat
 {
+	// Initial state of a particle, copied into a ParticleStore when added to a layer.
 	struct Particle
 	{
 		Vector2 pos;	// position in world space
@@ -15,8 +16,7 @@ namespace dukat
 		Color dc;		// Change in color / transparency per second
 		float dsize;	// Change in size per second
 		float ttl;		// time-to-live
-		bool rendered;	// true if this particle was rendered during last frame
 
-		Particle() : pos(), ry(0.0f), color(), size(1), dp(), dc(), dsize(0), ttl(0.0f), rendered(false) { }	
+		Particle() : pos(), ry(0.0f), color(), size(1), dp(), dc(), dsize(0), ttl(0.0f) { }	
 	};
 }
\ No newline at end of file
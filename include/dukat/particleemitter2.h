@@ -0,0 +1,92 @@
+#pragma once
+
+#include "effect2.h"
+#include "color.h"
+#include "vector2.h"
+
+#ifndef OPENGL_VERSION
+#include "version.h"
+#endif // !OPENGL_VERSION
+
+namespace dukat
+{
+	class Game2;
+	class ShaderProgram;
+
+	// Emits particles that live entirely in GPU memory. Particle state is kept
+	// in two vertex buffers; each frame a transform feedback pass reads one
+	// buffer, advances all particles and writes the result into the other.
+	// New particles are spawned on the GPU from a handful of uniforms, so no
+	// particle data is uploaded after creation. Drawing uses the particle
+	// program of the layer the emitter is added to.
+	//
+	// Particles are spawned into slots in ring order; when more particles are
+	// emitted than fit, the oldest ones are replaced. Capacity should therefore
+	// be at least rate * max_ttl. Requires OpenGL 3.0 or OpenGL ES 3.0.
+	class ParticleEmitter2 : public Effect2
+	{
+	public:
+		// Spawn parameters, uploaded once per frame.
+		struct Params
+		{
+			Vector2 pos;				// center of spawn area
+			Vector2 spread;				// half extents of spawn area
+			Vector2 min_dp, max_dp;		// range of initial velocity
+			Color color;				// initial color
+			Color dc;					// change in color per second
+			float min_size, max_size;	// range of initial size
+			float dsize;				// change in size per second
+			float min_ttl, max_ttl;		// range of time-to-live
+			float ry;					// axis of reflection
+			float rate;					// particles emitted per second
+
+			Params(void) : pos(), spread(), min_dp(), max_dp(), color({ 1.0f, 1.0f, 1.0f, 1.0f }), dc({ 0.0f, 0.0f, 0.0f, 0.0f }),
+				min_size(1.0f), max_size(1.0f), dsize(0.0f), min_ttl(1.0f), max_ttl(1.0f), ry(0.0f), rate(0.0f) { }
+		};
+
+	private:
+		Game2* game;
+		const int capacity;
+		ShaderProgram* update_program;
+		// Particle state, ping-ponged between two buffers.
+		GLuint buffers[2];
+#if OPENGL_VERSION >= 30
+		GLuint vao;
+#endif
+		// Index of the buffer holding the current state.
+		int current;
+		// Number of slots that have ever been spawned into.
+		int active;
+		// Next slot to spawn into.
+		int next_slot;
+		// Time not yet simulated.
+		float pending_time;
+		// Fractional particles carried over between frames.
+		float pending_spawn;
+		// Particles requested through burst.
+		int pending_burst;
+		unsigned int seed;
+
+		// Advances all particles by the pending time and spawns new ones.
+		void simulate(Renderer2* renderer);
+
+	public:
+		Params params;
+
+		ParticleEmitter2(Game2* game, int capacity);
+		~ParticleEmitter2(void);
+		ParticleEmitter2(const ParticleEmitter2&) = delete;
+		ParticleEmitter2& operator=(const ParticleEmitter2&) = delete;
+
+		// Records time passed. Called by the particle manager; simulation
+		// is deferred to render, which owns the GL context.
+		void update(float delta);
+		// Emits count particles with the next update, in addition to rate.
+		void burst(int count) { pending_burst += count; }
+		// Kills all particles.
+		void clear(void);
+		void render(Renderer2* renderer, const AABB2& camera_bb);
+
+		int get_capacity(void) const { return capacity; }
+	};
+}
@@ -1,31 +1,40 @@
 #pragma once
 
-#include <deque>
 #include <memory>
+#include <vector>
 
 #include "particle.h"
+#include "particlestore.h"
 #include "manager.h"
 
 namespace dukat
 {
-	// Manager in charge of all particles on screen. 
+	class ParticleEmitter2;
+
+	// Manager in charge of all particles on screen. Particles are kept in
+	// one store per render layer, each limited to a budget. GPU emitters
+	// register themselves here to be advanced along with the stores.
 	class ParticleManager : public Manager
 	{
 	private:
-		// Global limit to number of particles. Once that limit is hit, the system will
-		// recycle old particles.
-		static const int max_particles = 1000;
-		std::deque<std::unique_ptr<Particle>> particles;
+		std::vector<std::unique_ptr<ParticleStore>> stores;
+		std::vector<ParticleEmitter2*> emitters;
 
 	public:
+		// Number of particles a store holds unless configured otherwise.
+		static const int default_budget = 16384;
+
 		ParticleManager(GameBase* game) : Manager(game) { }
 		~ParticleManager(void) { }
 
 		// Updates all particles position in space.
 		void update(float delta);
-		// Creates a new particle.
-		Particle* create_particle(void);
-		// Adds an existing partilce to be managed us.
-		void add_particle(std::unique_ptr<Particle> particle);
+		// Creates a store for up to budget particles.
+		ParticleStore* create_store(int budget = default_budget);
+		void destroy_store(ParticleStore* store);
+		void add_emitter(ParticleEmitter2* emitter) { emitters.push_back(emitter); }
+		void remove_emitter(ParticleEmitter2* emitter);
+		// Returns the number of live particles across all stores, excluding emitters.
+		int particle_count(void) const;
 	};
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "particle.h"
+
+namespace dukat
+{
+	class WorkerPool;
+
+	// Stores particles as a structure of arrays, with one array per attribute.
+	// Particles are not addressable once added. Updates work on fixed-size
+	// chunks: each chunk is advanced and compacted on its own, then the gaps
+	// left behind are filled with particles from the end of the arrays. Moves
+	// only depend on the number of live particles per chunk, so the result is
+	// the same no matter how chunks were distributed across threads.
+	class ParticleStore
+	{
+	public:
+		// Number of particles per unit of work.
+		static constexpr int chunk_size = 4096;
+
+	private:
+		typedef std::array<std::vector<float>*, 16> AttributeList;
+
+		// Copy of a run of particles into a gap.
+		struct Move
+		{
+			int dst, src, count;
+		};
+
+		// Maximum number of live particles.
+		int capacity;
+		// Number of live particles per chunk after compaction.
+		std::vector<int> chunk_live;
+		std::vector<Move> moves;
+
+		AttributeList attributes(void);
+		// Advances the particles of a chunk and moves live ones to its front.
+		void update_chunk(int chunk, float delta);
+		// Plans moves that close the gaps between chunks, given live particles in total.
+		void plan_moves(int live);
+		void apply_move(const Move& move);
+
+	public:
+		// Attribute arrays, all of length size(). Read-only outside of this class.
+		std::vector<float> px, py;			// position in world space
+		std::vector<float> ry;				// axis of reflection
+		std::vector<float> size;			// size
+		std::vector<float> cr, cg, cb, ca;	// color
+		std::vector<float> dpx, dpy;		// change in position per second
+		std::vector<float> dcr, dcg, dcb, dca;	// change in color per second
+		std::vector<float> dsize;			// change in size per second
+		std::vector<float> ttl;				// time-to-live
+
+		ParticleStore(int capacity) : capacity(capacity) { }
+		~ParticleStore(void) { }
+
+		// Adds a particle. Returns false if the store is at capacity.
+		bool add(const Particle& p);
+		// Removes all particles.
+		void clear(void);
+		// Advances all particles by delta seconds and removes the ones that expired.
+		// Chunks are distributed across the pool if one is given.
+		void update(float delta, WorkerPool* pool = nullptr);
+
+		int count(void) const { return static_cast<int>(ttl.size()); }
+		bool empty(void) const { return ttl.empty(); }
+		int get_capacity(void) const { return capacity; }
+		// Changes the capacity. Particles beyond the new capacity are dropped.
+		void set_capacity(int capacity);
+	};
+}
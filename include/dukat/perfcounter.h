@@ -32,6 +32,12 @@ namespace dukat
 			SAMPLES,		// No# of sampling operations
 			BB_CHECKS,		// No# of bounding-box checks
 			ENTITIES,		// No# of game entities
+			BODIES_AWAKE,	// No# of awake collision bodies
+			BODIES_ASLEEP,	// No# of sleeping collision bodies
+			DRAW_CALLS,		// No# of sprite draw calls
+			SPRITE_SORT,	// Time spent sorting sprites in microseconds
+			SPRITE_PREPARE,	// Time spent culling and packing sprites in microseconds
+			SPRITE_SUBMIT,	// Time spent uploading and drawing sprites in microseconds
 			CUSTOM1,		// Custom counters
 			CUSTOM2,
 			CUSTOM3,
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dukat
+{
+	// Records timed zones of CPU work and exports them in the Chrome trace
+	// event format, to be viewed with chrome://tracing. Every thread writes
+	// to a ring buffer of its own, so recording takes no locks; while not
+	// recording, a zone costs a single flag check.
+	class Profiler
+	{
+	public:
+		struct Zone
+		{
+			// Must point to a string that outlives the profiler, such as a literal.
+			const char* name;
+			// Times in nanoseconds
+			int64_t start;
+			int64_t duration;
+		};
+
+	private:
+		// Number of zones kept per thread, most recent ones first to go.
+		static constexpr uint32_t buffer_size = 1u << 16;
+
+		struct ThreadBuffer
+		{
+			int thread_id;
+			std::unique_ptr<Zone[]> zones;
+			// Total number of zones written, wraps around buffer_size.
+			std::atomic<uint32_t> count;
+
+			ThreadBuffer(int thread_id) : thread_id(thread_id), zones(std::make_unique<Zone[]>(buffer_size)), count(0u) { }
+		};
+
+		std::atomic<bool> recording;
+		// Start of the current recording; older zones are not exported.
+		std::atomic<int64_t> since;
+		// Guards the list of buffers, which only changes when a thread records its first zone.
+		std::mutex mtx;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+		ThreadBuffer* get_thread_buffer(void);
+
+	public:
+		Profiler(void) : recording(false), since(0) { }
+		~Profiler(void) { }
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		// Returns a monotonic timestamp in nanoseconds.
+		static int64_t now(void);
+
+		// Discards zones recorded so far and starts recording.
+		void start(void);
+		void stop(void) { recording.store(false, std::memory_order_relaxed); }
+		bool is_recording(void) const { return recording.load(std::memory_order_relaxed); }
+		// Adds a zone to the calling thread's buffer.
+		void record(const char* name, int64_t start, int64_t end);
+		// Writes all zones recorded since start to a Chrome trace file. Should
+		// be called while no other thread is recording, e.g. between frames.
+		bool save(const std::string& filename);
+	};
+
+	extern Profiler profiler;
+
+	// Records the time between construction and destruction as a zone.
+	class ProfileZone
+	{
+	private:
+		const char* name;
+		int64_t start;
+
+	public:
+		ProfileZone(const char* name) : name(name), start(profiler.is_recording() ? Profiler::now() : -1) { }
+		~ProfileZone(void)
+		{
+			if (start >= 0)
+				profiler.record(name, start, Profiler::now());
+		}
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+	};
+}
@@ -1,46 +1,114 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <vector>
+#include "mathutil.h"
 #include "vector2.h"
 
 namespace dukat
 {
+	// Returns the bounding box used to place a value in a quadtree. Overload
+	// for types that should be partitioned by something other than their bb.
+	template<class T>
+	inline const auto& quadtree_bounds(const T* value) { return value->bb; }
+
 	// Quadtree used to partition space during collision detection.
+	// Nodes are persistent - once a child has been split off it is kept
+	// until the tree is cleared, so values can be moved between nodes
+	// from frame to frame without reallocating the tree.
 	template<class T>
 	class QuadTree
 	{
 	private:
 		const int max_depth;
 		const int depth;
-		std::list<T*> values;
+		QuadTree<T>* const parent;
+		// Region of space that maps to this node during insert. Nodes on
+		// the border of the tree extend to infinity, since values outside
+		// of [min, max] will be assigned to those nodes as well.
+		Vector2 region_min;
+		Vector2 region_max;
+		std::vector<T*> values;
 		std::unique_ptr<QuadTree<T>> children[4];
+		// Aggregate mask of all values in this node and its children.
+		uint32_t mask;
+
+		QuadTree(QuadTree<T>* parent, const Vector2& min, const Vector2& max,
+			const Vector2& region_min, const Vector2& region_max, int max_depth, int depth)
+			: max_depth(max_depth), depth(depth), parent(parent), region_min(region_min), region_max(region_max),
+			mask(0xffffffff), min(min), max(max), center(min + (max - min) * 0.5f) { }
+
+		// Creates child node for a quadrant.
+		void split(int index);
 
 	public:
 		const Vector2 min;
 		const Vector2 max;
 		const Vector2 center;
 
-		QuadTree(const Vector2& min, const Vector2& max, int max_depth, int depth = 0)
-			: max_depth(max_depth), depth(depth), min(min), max(max), center(min + (max - min) * 0.5f)
-		{
-			children[0] = nullptr;
-			children[1] = nullptr;
-			children[2] = nullptr;
-			children[3] = nullptr;
-		}
+		QuadTree(const Vector2& min, const Vector2& max, int max_depth)
+			: QuadTree(nullptr, min, max, Vector2{ -big_number, -big_number }, Vector2{ big_number, big_number }, max_depth, 0) { }
 		~QuadTree(void) { }
 
-		void insert(T* value);
+		// Inserts a value into this node or one of its children. Returns the node that holds the value.
+		QuadTree* insert(T* value);
+		// Removes a value from this node. Returns false if the value was not stored here.
+		bool remove(T* value);
+		// Checks if a value would still be inserted into this node.
+		bool fits(const T* value) const;
+		// Moves a value stored in this node to the node it currently fits in. Returns the new node.
+		QuadTree* relocate(T* value);
+		// Collects all values stored in nodes that overlap the bounding box of a value.
+		// Nodes whose aggregate mask does not share any bits with filter are skipped.
+		void query(const T* value, std::vector<T*>& res, uint32_t filter = 0xffffffff) const;
 		void clear(void);
+		// Calls fn(value) for each value in nodes for which pred(region_min, region_max, mask)
+		// returns true. Regions of nodes on the border of the tree extend to infinity.
+		template<typename P, typename F>
+		void visit(const P& pred, const F& fn) const;
+		// Recomputes aggregate masks of this node and its children, using fn(value) 
+		// as the mask of each value. Returns the mask of this node.
+		template<typename F>
+		uint32_t update_mask(F fn);
+		// Sets aggregate masks to match any filter.
+		void reset_mask(void);
 
-		int get_index(T* value) const;
+		int get_index(const T* value) const;
 		bool has_child(int index) const { return children[index] != nullptr; }
 		QuadTree* child(int index) const { return (children[index] == nullptr) ? nullptr : children[index].get(); }
-		const std::list<T*>& get_values(void) const { return values; }
+		QuadTree* get_parent(void) const { return parent; }
+		const std::vector<T*>& get_values(void) const { return values; }
+		uint32_t get_mask(void) const { return mask; }
 	};
 
 	template<class T>
-	void QuadTree<T>::insert(T* value)
+	void QuadTree<T>::split(int index)
+	{
+		switch (index)
+		{
+		case 0:
+			children[0] = std::unique_ptr<QuadTree<T>>(new QuadTree<T>(this, Vector2{ center.x, min.y }, Vector2{ max.x, center.y },
+				Vector2{ center.x, region_min.y }, Vector2{ region_max.x, center.y }, max_depth, depth + 1));
+			break;
+		case 1:
+			children[1] = std::unique_ptr<QuadTree<T>>(new QuadTree<T>(this, Vector2{ center.x, center.y }, Vector2{ max.x, max.y },
+				Vector2{ center.x, center.y }, Vector2{ region_max.x, region_max.y }, max_depth, depth + 1));
+			break;
+		case 2:
+			children[2] = std::unique_ptr<QuadTree<T>>(new QuadTree<T>(this, Vector2{ min.x, center.y }, Vector2{ center.x, max.y },
+				Vector2{ region_min.x, center.y }, Vector2{ center.x, region_max.y }, max_depth, depth + 1));
+			break;
+		case 3:
+			children[3] = std::unique_ptr<QuadTree<T>>(new QuadTree<T>(this, Vector2{ min.x, min.y }, Vector2{ center.x, center.y },
+				Vector2{ region_min.x, region_min.y }, Vector2{ center.x, center.y }, max_depth, depth + 1));
+			break;
+		}
+	}
+
+	template<class T>
+	QuadTree<T>* QuadTree<T>::insert(T* value)
 	{
 		auto idx = get_index(value);
 		if (idx > -1 && depth < max_depth)
@@ -48,27 +116,76 @@ namespace dukat
 			// split if necessary
 			if (children[idx] == nullptr)
 			{
-				switch (idx)
-				{
-				case 0:
-					children[0] = std::make_unique<QuadTree<T>>(Vector2{ center.x, min.y }, Vector2{ max.x, center.y }, max_depth, depth + 1);
-					break;
-				case 1:
-					children[1] = std::make_unique<QuadTree<T>>(Vector2{ center.x, center.y }, Vector2{ max.x, max.y }, max_depth, depth + 1);
-					break;
-				case 2:
-					children[2] = std::make_unique<QuadTree<T>>(Vector2{ min.x, center.y }, Vector2{ center.x, max.y }, max_depth, depth + 1);
-					break;
-				case 3:
-					children[3] = std::make_unique<QuadTree<T>>(Vector2{ min.x, min.y }, Vector2{ center.x, center.y }, max_depth, depth + 1);
-					break;
-				}
+				split(idx);
 			}
-			children[idx]->insert(value);
+			return children[idx]->insert(value);
 		}
 		else
 		{
 			values.push_back(value);
+			return this;
+		}
+	}
+
+	template<class T>
+	bool QuadTree<T>::remove(T* value)
+	{
+		auto it = std::find(values.begin(), values.end(), value);
+		if (it == values.end())
+			return false;
+		// order of values does not matter, so swap with last element
+		*it = values.back();
+		values.pop_back();
+		return true;
+	}
+
+	template<class T>
+	bool QuadTree<T>::fits(const T* value) const
+	{
+		const auto& bb = quadtree_bounds(value);
+		if (bb.min.x < region_min.x || bb.max.x >= region_max.x
+			|| bb.min.y < region_min.y || bb.max.y >= region_max.y)
+			return false;
+		return depth >= max_depth || get_index(value) == -1;
+	}
+
+	template<class T>
+	QuadTree<T>* QuadTree<T>::relocate(T* value)
+	{
+		if (fits(value))
+			return this;
+
+		remove(value);
+		// Walk up until we find a node that contains the value - since
+		// all splits above that node are still valid, inserting from there
+		// yields the same node as inserting from the root.
+		const auto& bb = quadtree_bounds(value);
+		auto node = this;
+		while (node->parent != nullptr)
+		{
+			node = node->parent;
+			if (bb.min.x >= node->region_min.x && bb.max.x < node->region_max.x
+				&& bb.min.y >= node->region_min.y && bb.max.y < node->region_max.y)
+				break;
+		}
+		return node->insert(value);
+	}
+
+	template<class T>
+	void QuadTree<T>::query(const T* value, std::vector<T*>& res, uint32_t filter) const
+	{
+		if ((mask & filter) == 0)
+			return;
+		const auto& bb = quadtree_bounds(value);
+		if (bb.max.x < region_min.x || bb.min.x > region_max.x
+			|| bb.max.y < region_min.y || bb.min.y > region_max.y)
+			return;
+
+		res.insert(res.end(), values.begin(), values.end());
+		for (const auto& c : children)
+		{
+			if (c != nullptr)
+				c->query(value, res, filter);
 		}
 	}
 
@@ -80,30 +197,77 @@ namespace dukat
 		children[2] = nullptr;
 		children[3] = nullptr;
 		values.clear();
+		mask = 0xffffffff;
+	}
+
+	template<class T>
+	template<typename P, typename F>
+	void QuadTree<T>::visit(const P& pred, const F& fn) const
+	{
+		if (!pred(region_min, region_max, mask))
+			return;
+		for (auto v : values)
+		{
+			fn(v);
+		}
+		for (const auto& c : children)
+		{
+			if (c != nullptr)
+				c->visit(pred, fn);
+		}
+	}
+
+	template<class T>
+	template<typename F>
+	uint32_t QuadTree<T>::update_mask(F fn)
+	{
+		mask = 0;
+		for (auto v : values)
+		{
+			mask |= fn(v);
+		}
+		for (auto& c : children)
+		{
+			if (c != nullptr)
+				mask |= c->update_mask(fn);
+		}
+		return mask;
+	}
+
+	template<class T>
+	void QuadTree<T>::reset_mask(void)
+	{
+		mask = 0xffffffff;
+		for (auto& c : children)
+		{
+			if (c != nullptr)
+				c->reset_mask();
+		}
 	}
 
 	template<class T>
-	int QuadTree<T>::get_index(T* value) const
+	int QuadTree<T>::get_index(const T* value) const
 	{
+		const auto& bb = quadtree_bounds(value);
 		auto res = -1;
-		if (value->bb.max.x < center.x) // value is in left quadrants
+		if (bb.max.x < center.x) // value is in left quadrants
 		{
-			if (value->bb.max.y < center.y) // value is in top-left quadrant
+			if (bb.max.y < center.y) // value is in top-left quadrant
 			{
 				res = 3;
 			}
-			else if (value->bb.min.y >= center.y) // value is in bottom-left quadrant
+			else if (bb.min.y >= center.y) // value is in bottom-left quadrant
 			{
 				res = 2;
 			}
 		}
-		else if (value->bb.min.x >= center.x) // value is in right quadrants
+		else if (bb.min.x >= center.x) // value is in right quadrants
 		{
-			if (value->bb.max.y < center.y) // value is in top-right quadrant
+			if (bb.max.y < center.y) // value is in top-right quadrant
 			{
 				res = 0;
 			}
-			else if (value->bb.min.y >= center.y) // value is in bottom-right quadrant
+			else if (bb.min.y >= center.y) // value is in bottom-right quadrant
 			{
 				res = 1;
 			}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dukat
+{
+	// Sorts items by their 64-bit key member in ascending order. The sort is
+	// stable, so items with equal keys keep their relative order. Runs one
+	// pass per key byte that differs between items, using tmp as scratch space.
+	template<typename T>
+	void radix_sort(std::vector<T>& items, std::vector<T>& tmp)
+	{
+		const auto count = items.size();
+		// small inputs are faster to sort in place
+		if (count < 64)
+		{
+			for (auto i = 1u; i < count; i++)
+			{
+				auto item = items[i];
+				auto j = i;
+				while (j > 0 && items[j - 1].key > item.key)
+				{
+					items[j] = items[j - 1];
+					j--;
+				}
+				items[j] = item;
+			}
+			return;
+		}
+
+		// build histograms for all bytes at once
+		uint32_t histograms[8][256] = { };
+		for (const auto& item : items)
+		{
+			auto key = item.key;
+			for (auto b = 0; b < 8; b++, key >>= 8)
+			{
+				histograms[b][key & 0xff]++;
+			}
+		}
+
+		tmp.resize(count);
+		auto src = &items;
+		auto dst = &tmp;
+		for (auto b = 0; b < 8; b++)
+		{
+			auto& histogram = histograms[b];
+			// skip bytes that are the same for all items
+			if (histogram[((*src)[0].key >> (8 * b)) & 0xff] == count)
+				continue;
+
+			// turn counts into offsets
+			uint32_t offset = 0;
+			for (auto& h : histogram)
+			{
+				const auto c = h;
+				h = offset;
+				offset += c;
+			}
+
+			for (const auto& item : *src)
+			{
+				(*dst)[histogram[(item.key >> (8 * b)) & 0xff]++] = item;
+			}
+			std::swap(src, dst);
+		}
+
+		if (src != &items)
+		{
+			items.swap(tmp);
+		}
+	}
+}
@@ -15,12 +15,15 @@
 #include "matrix4.h"
 #include "renderer.h"
 #include "renderlayer2.h"
+#include "streambuffer.h"
 
 namespace dukat
 {
 	// Forward declarations
 	class MeshData;
 	struct Sprite;
+	class ParticleManager;
+	class WorkerPool;
 
 	// 2D Renderer
 	// The coordinate system used assumes that the x-axis goes towards the right and the y-axis
@@ -31,11 +34,19 @@ namespace dukat
 		std::unique_ptr<Camera2> camera;
 		std::unique_ptr<VertexBuffer> sprite_buffer;
 		std::unique_ptr<VertexBuffer> particle_buffer;
+		// Ring buffer particles of all layers are written to each frame.
+		std::unique_ptr<StreamBuffer> particle_stream;
 		std::unique_ptr<FrameBuffer> frame_buffer;
 		// Used to compose the layers into a single image.
 		std::unique_ptr<MeshData> quad;
 		// list of layers ordered by priority
 		std::vector<std::unique_ptr<RenderLayer2>> layers;
+		// Used to prepare sprites of multiple layers in parallel.
+		WorkerPool* worker_pool;
+		// Owns the particles of each layer.
+		ParticleManager* particle_manager;
+		// Layers whose sprites are prepared at the start of the current frame.
+		std::vector<RenderLayer2*> prepared_layers;
 		// just a single light for now
 		Light light;
 		// Render flags
@@ -47,9 +58,14 @@ namespace dukat
 		void initialize_sprite_buffers(void);
 		void initialize_particle_buffers(void);
 		void initialize_frame_buffer(void);
+		// Culls and packs sprites of all visible layers before any drawing takes place.
+		void prepare_sprites(void);
 
 	public:
-		static const int max_particles = 2048;
+		// Maximum number of particles streamed per frame across all layers.
+		static const int max_particles = 262144;
+		// Maximum number of sprites uploaded per batch.
+		static const int max_sprite_batch = 4096;
 
 #if OPENGL_VERSION <= 30
 		static constexpr const char* u_cam_dimension = "u_cam_dimension";
@@ -78,6 +94,9 @@ namespace dukat
 		// Updates uniform buffers for camera and lighting.
 		void update_uniforms(void);
 		void set_light(const Light& light) { this->light = light; }
+		void set_worker_pool(WorkerPool* worker_pool) { this->worker_pool = worker_pool; }
+		// Sets the manager that stores particles of layers created afterwards.
+		void set_particle_manager(ParticleManager* particle_manager) { this->particle_manager = particle_manager; }
 		// Gets / sets flags
 		void set_render_particles(bool val) { render_particles = val; }
 		bool is_render_particles(void) const { return render_particles; }
@@ -1,53 +1,105 @@
 #pragma once
 
-#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
-#include <queue>
 
 #ifndef OPENGL_VERSION
 #include "version.h"
 #endif // !OPENGL_VERSION
 
 #include "color.h"
+#include "matrix4.h"
 #include "sprite.h"
 #include "renderer.h"
+#include "vertextypes2.h"
+
+// Sprites are drawn in instanced batches where supported (OpenGL 3.3 / ES 3.0).
+#if OPENGL_CORE >= 33 || OPENGL_ES >= 30
+#define SPRITE_INSTANCING
+#endif
 
 namespace dukat
 {
 	class AABB2;
 	class Camera2;
 	class Effect2;
-	class Matrix4;
 	struct Particle;
+	class ParticleManager;
+	class ParticleStore;
 	class Renderer2;
 	class ShaderCache;
 	class ShaderProgram;
+	class SpriteChunkCache;
+	class SpriteGrid;
+	class StreamBuffer;
 	class TextMeshInstance;
 	struct VertexBuffer;
 
 	class RenderLayer2
 	{
 	private:
+		// Visible sprite along with its sort key.
+		struct SpriteEntry
+		{
+			uint64_t key;
+			Sprite* sprite;
+		};
+
 		ShaderProgram* sprite_program;
 		ShaderProgram* particle_program;
 		ShaderProgram* composite_program;
 		std::function<void(ShaderProgram*)> composite_binder;
+		ShaderCache* shader_cache;
 		VertexBuffer* sprite_buffer;
 		VertexBuffer* particle_buffer;
+		StreamBuffer* particle_stream;
 		std::vector<std::unique_ptr<Effect2>> effects;
 		std::vector<Sprite*> sprites;
-		std::deque<Particle*> particles;
+		// Optional index over sprites not positioned relative to the camera.
+		std::unique_ptr<SpriteGrid> sprite_grid;
+		// Baked sprites not positioned relative to the camera, if this layer is static.
+		std::unique_ptr<SpriteChunkCache> static_sprites;
+		// Sprites positioned relative to the camera, if sprites are indexed.
+		std::vector<Sprite*> relative_sprites;
+		// Visible sprites in rendering order, and scratch space for sorting them.
+		std::vector<SpriteEntry> visible_sprites;
+		std::vector<SpriteEntry> sort_buffer;
+		// Per-sprite data packed by prepare_sprites, in the order of visible_sprites.
+#ifdef SPRITE_INSTANCING
+		std::vector<Vertex2PSRTC> sprite_instances;
+#else
+		std::vector<Matrix4> sprite_models;
+#endif
+		// True if sprites have been prepared for the current frame.
+		bool sprites_prepared;
+		// Time spent sorting during the last prepare in microseconds.
+		int sort_time;
+		ParticleManager* particle_manager;
+		// Particles of this layer, created when the first particle is added.
+		ParticleStore* particles;
+		int particle_budget;
 		std::vector<TextMeshInstance*> texts;
 		bool is_visible;
 
-		// Fills up priority queue with visible sprites.
-		void fill_sprite_queue(const AABB2& camera_bb, 
-			std::priority_queue<Sprite*, std::deque<Sprite*>, SpriteComparator>& queue);
+		// Returns true if sprites are kept in a grid or baked into chunks.
+		bool is_indexed(void) const { return sprite_grid != nullptr || static_sprites != nullptr; }
+		// Adds a sprite to the grid, chunk cache or relative sprites.
+		void index(Sprite* sprite);
+		void unindex(Sprite* sprite);
+		// Re-adds all sprites after the grid or chunk cache have changed.
+		void rebuild_index(void);
+		// Collects visible sprites and sorts them in rendering order.
+		void collect_sprites(const AABB2& camera_bb);
+		// Draws the prepared sprites in [begin, end) of visible_sprites.
+		void draw_sprites(Renderer2* renderer, int begin, int end);
+		// Returns the area visible through the camera, adjusted for parallax.
+		AABB2 camera_bounds(const Camera2* camera) const;
 
+		// Computes the position of a sprite's center after alignment.
+		Vector2 compute_position(const Sprite& sprite, const Vector2& camera_position) const;
 		// Generates sprite model matrix.
-		void compute_model_matrix(const Sprite& sprite, const Vector2& camera_position, Matrix4& mat_model);
+		void compute_model_matrix(const Sprite& sprite, const Vector2& camera_position, Matrix4& mat_model) const;
 
 	public:
 		const std::string id;
@@ -59,24 +111,31 @@ namespace dukat
 		RenderStage stage;
 
 		// Constructor
-		RenderLayer2(ShaderCache* shader_cache, VertexBuffer* sprite_buffer, VertexBuffer* particle_buffer,
-			const std::string& id, float priority, float parallax = 1.0f);
+		RenderLayer2(ShaderCache* shader_cache, VertexBuffer* sprite_buffer, VertexBuffer* particle_buffer, StreamBuffer* particle_stream,
+			ParticleManager* particle_manager, const std::string& id, float priority, float parallax = 1.0f);
 		~RenderLayer2(void);
 
 		bool has_effects(void) const { return !effects.empty(); }
 		bool has_sprites(void) const { return !sprites.empty(); }
-		bool has_particles(void) const { return !particles.empty(); }
+		bool has_particles(void) const;
 		bool has_text(void) const { return !texts.empty(); }
 
 		Effect2* add(std::unique_ptr<Effect2> fx);
 		void remove(Effect2* fx);
 		void add(Sprite* sprite);
 		void remove(Sprite* sprite);
-		void add(Particle* p);
-		void remove(Particle* p);
+		// Notifies the layer that a sprite's position, size, scale, alignment or 
+		// relative flag has changed. Only required if a sprite grid is used or the
+		// layer is static; static layers also require this for any other change.
+		void update(Sprite* sprite);
+		// Adds a particle to this layer. Returns false if the particle budget is exhausted.
+		bool add(const Particle& p);
 		void add(TextMeshInstance* text);
 		void remove(TextMeshInstance* text);
 		
+		// Culls, sorts and packs visible sprites ahead of render_sprites. Issues no
+		// GL calls and only touches this layer, so layers can be prepared concurrently.
+		void prepare_sprites(const Camera2* camera);
 		void render(Renderer2* renderer);
 		void render_effects(Renderer2* renderer, const AABB2& camera_bb);
 		void render_sprites(Renderer2* renderer, const AABB2& camera_bb);
@@ -88,6 +147,19 @@ namespace dukat
 		bool visible(void) const { return is_visible; }
 		// Removes all renderables from this layer.
 		void clear(void);
+		// Indexes sprites in a grid with a given cell size, so only sprites near the 
+		// camera are tested for visibility. A cell size of 0 disables the grid.
+		void set_sprite_grid(float cell_size);
+		bool has_sprite_grid(void) const { return sprite_grid != nullptr; }
+		// Bakes sprites into vertex buffers, split into chunks of a given size. Chunks
+		// are rebuilt when sprites are added, removed or updated, so static layers suit 
+		// backgrounds that rarely change. Sprites relative to the camera are not baked;
+		// they are drawn between chunks by z value, after baked sprites of equal z.
+		void set_static(bool static_layer, float chunk_size = 1024.0f);
+		bool is_static(void) const { return static_sprites != nullptr; }
+		// Limits the number of live particles of this layer.
+		void set_particle_budget(int budget);
+		int get_particle_budget(void) const { return particle_budget; }
 
 		ShaderProgram* get_sprite_program(void) const { return sprite_program; }
 		void set_sprite_program(ShaderProgram* sprite_program) { this->sprite_program = sprite_program; }
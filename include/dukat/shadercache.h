@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #ifndef OPENGL_VERSION
 #include "version.h"
@@ -36,9 +37,10 @@ namespace dukat
 		std::string load_shader(const std::string& filename);
 		// Builds a new shader from a source file.
 		GLuint build_shader(GLenum shaderType, const std::string& filename);
-		// Builds a new program from a set of source files.
+		// Builds a new program from a set of source files. Outputs listed in
+		// varyings are captured by transform feedback into a single buffer.
 		GLuint build_program(const std::string& vertex_file, const std::string& fragement_file,
-			const std::string& geometry_file = "");
+			const std::string& geometry_file = "", const std::vector<std::string>& varyings = std::vector<std::string>());
 
 	public:
 		ShaderCache(const std::string& resource_dir) : resource_dir(resource_dir) { }
@@ -47,6 +49,10 @@ namespace dukat
 		// Returns a program for a set of shaders. If necessary, will create the program.
 		ShaderProgram* get_program(const std::string& vertex_file, const std::string& fragement_file,
 			const std::string& geometry_file = "");
+		// Returns a program whose vertex shader outputs are recorded with transform
+		// feedback, interleaved in the order given by varyings.
+		ShaderProgram* get_feedback_program(const std::string& vertex_file, const std::string& fragement_file,
+			const std::vector<std::string>& varyings);
 	};
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include "color.h"
 #include "texturecache.h"
@@ -7,6 +9,7 @@
 
 namespace dukat
 {
+	class AABB2;
 	struct Rect;
 	class Matrix4;
 
@@ -59,6 +62,8 @@ namespace dukat
 		
 		// Sprite map functions
 		void set_index(int index);
+		// Returns the area covered by this sprite, ignoring rotation.
+		AABB2 bounds(void) const;
 
 		// Operator to decrement / increment index for sprite map
 		Sprite& operator++(void);
@@ -66,6 +71,18 @@ namespace dukat
 
 		bool operator<(const Sprite& s) const { return z < s.z; }
 		bool operator>(const Sprite& s) const { return z > s.z; }
+
+		// Returns a key that orders sprites the same way as SpriteComparator, 
+		// with z in the upper and texture ID in the lower 32 bits.
+		uint64_t sort_key(void) const
+		{
+			const auto z0 = z + 0.0f; // treat -0 as 0
+			uint32_t bits;
+			std::memcpy(&bits, &z0, sizeof(bits));
+			// flip sign bit of positive values and all bits of negative ones
+			bits ^= (bits & 0x80000000) ? 0xffffffff : 0x80000000;
+			return (static_cast<uint64_t>(bits) << 32) | static_cast<uint32_t>(texture_id);
+		}
 	};
 
 	// Used to order entities by z value. For sprites with the same z value,
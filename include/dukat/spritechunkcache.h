@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#ifndef OPENGL_VERSION
+#include "version.h"
+#endif // !OPENGL_VERSION
+
+#include "aabb2.h"
+
+namespace dukat
+{
+	class Renderer2;
+	class ShaderProgram;
+	struct Sprite;
+	struct VertexBuffer;
+
+	// Bakes the sprites of a static layer into vertex buffers. Sprites are split
+	// into square chunks by position and z value; each chunk holds a single
+	// buffer in world space with its sprites grouped by texture. Chunks are
+	// only rebuilt when their sprites change.
+	class SpriteChunkCache
+	{
+	private:
+		// Range of vertices drawn with a single texture.
+		struct Run
+		{
+			GLuint texture;
+			GLint first;
+			GLsizei count;
+		};
+
+		struct Chunk
+		{
+			std::vector<Sprite*> sprites;
+			std::unique_ptr<VertexBuffer> buffer;
+			std::vector<Run> runs;
+			// Area covered by the sprites of this chunk.
+			AABB2 bb;
+			bool dirty;
+			// True if this chunk was rendered during the last frame.
+			bool visible;
+
+			Chunk(void) : dirty(true), visible(false) { }
+		};
+
+		// Orders chunks by z value first, so they are rendered back to front.
+		typedef std::tuple<uint32_t, int, int> ChunkKey;
+
+		const float chunk_size;
+		ShaderProgram* program;
+		std::map<ChunkKey, std::unique_ptr<Chunk>> chunks;
+		// Chunk each sprite is stored in.
+		std::unordered_map<Sprite*, ChunkKey> locations;
+
+		ChunkKey chunk_key(const Sprite* sprite) const;
+		// Rebuilds the vertex buffer of a chunk.
+		void bake(Chunk& chunk);
+
+	public:
+		SpriteChunkCache(ShaderProgram* program, float chunk_size);
+		~SpriteChunkCache(void);
+
+		void add(Sprite* sprite);
+		void remove(Sprite* sprite);
+		// Rebakes the chunk of a sprite whose properties have changed.
+		void update(Sprite* sprite);
+		void clear(void);
+
+		// Rebuilds changed chunks and determines which chunks overlap camera_bb.
+		// Returns true if any chunk is visible.
+		bool prepare(const AABB2& camera_bb);
+		// Renders the visible chunks with a z key in [z_begin, z_end), where the
+		// z key is the upper half of Sprite::sort_key. Call prepare first.
+		void render(Renderer2* renderer, float parallax, uint64_t z_begin = 0, uint64_t z_end = 1ull << 32);
+
+		float get_chunk_size(void) const { return chunk_size; }
+		int chunk_count(void) const { return static_cast<int>(chunks.size()); }
+	};
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "aabb2.h"
+
+namespace dukat
+{
+	struct Sprite;
+
+	// Loose uniform grid used to cull sprites of a layer. Each sprite is stored
+	// in the cell containing its center, and queries are widened by the largest
+	// sprite extent, so a sprite only ever occupies a single cell.
+	class SpriteGrid
+	{
+	private:
+		const float cell_size;
+		std::unordered_map<uint64_t, std::vector<Sprite*>> cells;
+		// Cell each sprite is stored in.
+		std::unordered_map<Sprite*, uint64_t> locations;
+		// Largest half size of any sprite inserted so far.
+		Vector2 max_extent;
+
+		int cell_coord(float v) const { return static_cast<int>(std::floor(v / cell_size)); }
+		static uint64_t cell_key(int x, int y) { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y); }
+
+	public:
+		SpriteGrid(float cell_size) : cell_size(cell_size), max_extent(0.0f, 0.0f) { }
+		~SpriteGrid(void) { }
+
+		// Adds a sprite based on its current bounds.
+		void insert(Sprite* sprite);
+		void remove(Sprite* sprite);
+		// Moves a sprite to the cell matching its current bounds.
+		void update(Sprite* sprite);
+		void clear(void);
+		// Returns true if a sprite is stored in this grid.
+		bool contains(Sprite* sprite) const { return locations.count(sprite) > 0; }
+		// Calls fn(sprite) for each sprite that may overlap a box.
+		template<typename F>
+		void query(const AABB2& bb, const F& fn) const;
+
+		float get_cell_size(void) const { return cell_size; }
+		int size(void) const { return static_cast<int>(locations.size()); }
+	};
+
+	template<typename F>
+	void SpriteGrid::query(const AABB2& bb, const F& fn) const
+	{
+		if (cells.empty())
+			return;
+		// sprites are stored by center, so widen the search to catch overlapping ones
+		const auto min_x = cell_coord(bb.min.x - max_extent.x);
+		const auto max_x = cell_coord(bb.max.x + max_extent.x);
+		const auto min_y = cell_coord(bb.min.y - max_extent.y);
+		const auto max_y = cell_coord(bb.max.y + max_extent.y);
+		for (auto y = min_y; y <= max_y; y++)
+		{
+			for (auto x = min_x; x <= max_x; x++)
+			{
+				auto it = cells.find(cell_key(x, y));
+				if (it == cells.end())
+					continue;
+				for (auto sprite : it->second)
+				{
+					fn(sprite);
+				}
+			}
+		}
+	}
+}
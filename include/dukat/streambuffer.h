@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#ifndef OPENGL_VERSION
+#include "version.h"
+#endif // !OPENGL_VERSION
+
+// Sync objects and unsynchronized mapping are core in OpenGL 3.2 / ES 3.0.
+#if OPENGL_CORE >= 32 || OPENGL_ES >= 30
+#define STREAM_BUFFER_SYNC
+#endif
+
+namespace dukat
+{
+	// Ring buffer for vertex data that is rewritten every frame. The buffer is
+	// split into one region per frame in flight; writes go straight into mapped
+	// memory of the current region, and a fence guards each region until the
+	// GPU has finished reading it. Uses persistent mapping where available,
+	// unsynchronized mapping otherwise, and falls back to orphaning the buffer
+	// on versions without sync objects.
+	class StreamBuffer
+	{
+	public:
+		enum Mode
+		{
+			PERSISTENT,		// mapped once for the lifetime of the buffer
+			UNSYNCHRONIZED,	// mapped for each write without implicit synchronization
+			ORPHAN			// written to client memory and uploaded into a fresh buffer
+		};
+
+	private:
+		const GLenum target;
+		const GLsizeiptr region_size;
+		const int region_count;
+		Mode mode;
+		GLuint buffer;
+		// Base address of the persistently mapped buffer.
+		GLubyte* mapped;
+		// Client copy of written data in orphan mode, sized to the largest write.
+		std::vector<GLubyte> staging;
+		int region;
+		// Offset of the next write within the current region.
+		GLsizeiptr head;
+		// True while a range is mapped for writing.
+		bool range_mapped;
+#ifdef STREAM_BUFFER_SYNC
+		std::vector<GLsync> fences;
+#endif
+
+	public:
+		// Creates a buffer holding region_size bytes for each of region_count frames.
+		// In orphan mode, region_size only limits the size of a single write.
+		StreamBuffer(GLenum target, GLsizeiptr region_size, int region_count = 3);
+		~StreamBuffer(void);
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+		// Waits until the GPU is done with the next region and makes it current.
+		void begin_frame(void);
+		// Places a fence behind all commands reading the current region.
+		void end_frame(void);
+
+		// Reserves up to size bytes of the current region, reducing size to the
+		// space left. Returns a pointer to write-only memory and its offset within
+		// the buffer, or nullptr if the region is full. Data should be written in
+		// order and never read back, as the memory may be uncached.
+		GLvoid* map(GLsizeiptr& size, GLintptr& offset);
+		// Completes the last map, keeping the first size bytes that were written.
+		void unmap(GLsizeiptr size);
+
+		GLuint get_buffer(void) const { return buffer; }
+		Mode get_mode(void) const { return mode; }
+		// Returns the number of bytes still available in the current region.
+		GLsizeiptr available(void) const { return region_size - head; }
+	};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rect.h"
+#include "texture.h"
+
+namespace dukat
+{
+	class Surface;
+	struct Sprite;
+
+	// Packs rectangles into a fixed size area using the skyline bottom-left
+	// heuristic. The skyline tracks the top edge of all placed rectangles as
+	// a list of horizontal segments.
+	class SkylinePacker
+	{
+	private:
+		struct Segment
+		{
+			int x, y, w;
+		};
+
+		const int width, height;
+		std::vector<Segment> skyline;
+		int used_area;
+
+		// Returns the lowest y at which a rectangle of width w fits starting at segment i, or -1.
+		int fit(int i, int w, int h) const;
+		void place(int i, const Rect& r);
+
+	public:
+		SkylinePacker(int width, int height);
+		~SkylinePacker(void) { }
+
+		// Finds a position for a w x h rectangle. Returns false if it does not fit.
+		bool insert(int w, int h, Rect& r);
+		void clear(void);
+		// Returns the fraction of the area covered by rectangles.
+		float occupancy(void) const { return static_cast<float>(used_area) / static_cast<float>(width * height); }
+	};
+
+	// Combines many small images into a few large pages, so sprites using
+	// them can be drawn without switching textures. Images are added by name,
+	// packed with build() and turned into sprites with create_sprite().
+	// A packed atlas can be saved and loaded again to skip packing at startup.
+	class TextureAtlas
+	{
+	public:
+		struct Entry
+		{
+			int page;
+			// Area in pixels within the page.
+			Rect rect;
+		};
+
+	private:
+		const int page_width, page_height;
+		// Empty space left around each image.
+		const int padding;
+		// Images waiting to be packed.
+		std::vector<std::pair<std::string, std::unique_ptr<Surface>>> pending;
+		std::unordered_map<std::string, Entry> entries;
+		// Packers for pages that still accept images, starting at first_open_page.
+		std::vector<SkylinePacker> packers;
+		int first_open_page;
+		std::vector<std::unique_ptr<Surface>> page_surfaces;
+		std::vector<std::unique_ptr<Texture>> pages;
+
+	public:
+		TextureAtlas(int page_width = 2048, int page_height = 2048, int padding = 1);
+		~TextureAtlas(void);
+
+		// Queues an image for packing. The atlas takes ownership of the surface.
+		void add(const std::string& name, std::unique_ptr<Surface> surface);
+		// Queues a copy of a surface for packing.
+		void add(const std::string& name, const Surface& surface);
+		// Queues an image file for packing, using the filename as name.
+		void add_file(const std::string& filename);
+		// Packs all queued images into pages and uploads them as textures.
+		void build(TextureFilterProfile profile = ProfileNearest);
+		// Frees the CPU copies of all pages once they are no longer needed
+		// for saving. Images added afterwards are packed into new pages.
+		void discard_surfaces(void);
+
+		// Writes each page to <base>_<n>.png and the layout to <base>.atlas.
+		void save(const std::string& base) const;
+		// Replaces the contents of this atlas with an atlas written by save.
+		void load(const std::string& base, TextureFilterProfile profile = ProfileNearest);
+
+		// Returns the entry for an image, or nullptr if unknown.
+		const Entry* find(const std::string& name) const;
+		// Creates a sprite for an image with texture coordinates into its page.
+		std::unique_ptr<Sprite> create_sprite(const std::string& name) const;
+
+		Texture* get_page(int index) const { return pages[index].get(); }
+		int page_count(void) const { return static_cast<int>(pages.size()); }
+		int size(void) const { return static_cast<int>(entries.size()); }
+	};
+}
@@ -1,41 +1,103 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <functional>
-#include <list>
-#include <memory>
 
 #include "manager.h"
+#include "objectpool.h"
 
 namespace dukat
 {
-    struct Timer
-    {
+	struct Timer
+	{
 		uint32_t id;
-        float interval;
-        float remaining;
-        bool recurring;
-        std::function<void(void)> callback;
-
-        Timer(void) : id(0u), interval(0.0f), remaining(0.0f), recurring(false) { }
-        Timer(uint32_t id, float interval, std::function<void(void)> callback, bool recurring = false)
-			: id(id), interval(interval), remaining(interval), recurring(recurring), callback(callback) { }
-    };
-
-    class TimerManager : public Manager
-    {
-    private:
+		float interval;
+		bool recurring;
+		std::function<void(void)> callback;
+
+		// Absolute time in seconds at which the timer expires next.
+		double deadline;
+		// Tick of the wheel slot the timer is scheduled in.
+		uint64_t expires;
+		// Links within the wheel slot; pprev is null while the timer is not scheduled.
+		Timer* next;
+		Timer** pprev;
+		bool cancelled;
+
+		Timer(uint32_t id, float interval, std::function<void(void)> callback, bool recurring = false)
+			: id(id), interval(interval), recurring(recurring), callback(callback), deadline(0.0),
+			expires(0u), next(nullptr), pprev(nullptr), cancelled(false) { }
+	};
+
+	// Refers to a timer created by TimerManager. The id tells handles of
+	// timers that have fired or were cancelled apart from a new timer
+	// that reuses the same memory.
+	struct TimerHandle
+	{
+		Timer* timer;
+		uint32_t id;
+	};
+
+	// Schedules timers on a hierarchical timing wheel. Timers are sorted into
+	// slots of 1 ms ticks and only the slots that come due are visited, so the
+	// cost of an update depends on the number of expiring timers rather than
+	// the number of active ones. Timers further in the future are kept on
+	// coarser levels and moved down as their time approaches.
+	class TimerManager : public Manager
+	{
+	private:
+		static constexpr int wheel_bits = 8;
+		static constexpr int wheel_size = 1 << wheel_bits;
+		static constexpr int wheel_levels = 4;
+		static constexpr double ticks_per_second = 1000.0;
+
 		uint32_t last_id;
-        std::list<std::unique_ptr<Timer>> timers;
+		ObjectPool<Timer> timers;
+		std::array<std::array<Timer*, wheel_size>, wheel_levels> wheel;
+		// Timers scheduled for ticks the wheel has already passed.
+		Timer* waiting;
+		// Timers due in the tick being processed.
+		Timer* expiring;
+		// Timer whose callback is being invoked.
+		Timer* running;
+		// Time since creation in seconds.
+		double time;
+		// Last tick that has been processed.
+		uint64_t tick;
+
+		// Returns the tick the wheel advances to during the current update.
+		uint64_t current_tick(void) const { return static_cast<uint64_t>(time * ticks_per_second); }
+		// Inserts a timer into the wheel based on its deadline.
+		void schedule(Timer* timer);
+		// Inserts a timer into the slot that covers a tick.
+		void place(Timer* timer, uint64_t expires);
+		void link(Timer*& head, Timer* timer);
+		void unlink(Timer* timer);
+		// Moves the timers of the current slot on a level down to finer levels.
+		void cascade(int level);
+		// Invokes the timers of a list that are due and reschedules the others.
+		void expire(Timer*& head);
 
-    public:
-		TimerManager(GameBase* game) : Manager(game), last_id(0u) { }
+	public:
+		TimerManager(GameBase* game);
 		~TimerManager(void) { }
 
-        Timer* create_timer(float interval, std::function<void(void)> callback, bool recurring = false);
-        void cancel_timer(Timer* timer);
-        void update(float delta);
+		// Creates a timer that invokes callback after interval seconds.
+		// Recurring timers stay aligned to multiples of their interval; if
+		// several intervals pass within one update, the callback is invoked
+		// once and the missed intervals are skipped. The timer the returned
+		// handle points to is valid until it is cancelled or, for one-shot
+		// timers, has fired.
+		TimerHandle create_timer(float interval, std::function<void(void)> callback, bool recurring = false);
+		// Cancels a timer in constant time. May be called from timer callbacks.
+		// Handles of timers that have already fired or were cancelled are ignored.
+		void cancel_timer(const TimerHandle& handle);
+		void update(float delta);
 
 		// Cancels all active timers.
-		void clear(void) { timers.clear(); }
-    };
-}
\ No newline at end of file
+		void clear(void);
+		// Returns the number of active timers.
+		int size(void) const { return timers.size(); }
+	};
+}
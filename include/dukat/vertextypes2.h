@@ -40,4 +40,14 @@ namespace dukat
 		GLfloat ry;
 		GLfloat cr, cg, cb, ca;
 	};
+
+	// Per-instance data of a batched sprite.
+	struct Vertex2PSRTC
+	{
+		GLfloat px, py;
+		GLfloat sx, sy;
+		GLfloat rc, rs;	// cosine and sine of rotation
+		GLfloat tu, tv, tw, th;
+		GLfloat cr, cg, cb, ca;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dukat
+{
+	// Fixed set of worker threads used to split up work within a frame.
+	// The calling thread takes part in the work, so a pool with zero
+	// workers simply runs all jobs serially.
+	class WorkerPool
+	{
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mtx;
+		std::condition_variable work_cv;
+		std::condition_variable done_cv;
+		// Job currently being executed.
+		const std::function<void(int)>* job;
+		int job_count;
+		std::atomic<int> next_job;
+		std::atomic<int> completed_jobs;
+		// Number of workers currently executing jobs.
+		int active_workers;
+		// Incremented for every batch of jobs to wake up workers.
+		uint32_t batch;
+		bool stopping;
+
+		void worker_loop(void);
+		// Executes jobs until none are left.
+		void run_jobs(const std::function<void(int)>& fn, int count);
+
+	public:
+		// Creates a pool with a number of worker threads. If num_workers is
+		// negative, one worker per additional hardware thread is created.
+		WorkerPool(int num_workers = -1);
+		~WorkerPool(void);
+
+		// Returns the number of threads working on jobs, including the caller.
+		int thread_count(void) const { return static_cast<int>(workers.size()) + 1; }
+		// Calls fn(i) for each i in [0, count) and blocks until all calls have
+		// completed. Calls may run concurrently, so fn must be thread-safe.
+		void parallel_for(int count, const std::function<void(int)>& fn);
+	};
+}
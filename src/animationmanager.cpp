@@ -1,41 +1,58 @@
 #include "stdafx.h"
 #include <dukat/animationmanager.h>
+#include <dukat/profiler.h>
 
 namespace dukat
 {
 	Animation* AnimationManager::add(std::unique_ptr<Animation> animation)
 	{
 		auto anim = animation.get();
-		animations.push_back(std::move(animation));
-		if (!anim->is_running())
+		auto& pool = pools[anim->get_pool_type()];
+		if (pool == nullptr)
 		{
-			anim->start();
+			pool = anim->create_pool();
 		}
+		anim->attach(pool.get());
+		animations[anim] = std::move(animation);
 		return anim;
 	}
 
 	void AnimationManager::cancel(Animation* animation)
 	{
-		auto it = std::find_if(animations.begin(), animations.end(), [animation](const std::unique_ptr<Animation>& anim) {
-			return animation == anim.get();
-		});
-		if (it != animations.end())
-			animations.erase(it);
+		if (animations.count(animation))
+			animation->stop();
 	}
 
 	void AnimationManager::update(float delta)
 	{
-		for (auto it = animations.begin(); it != animations.end(); )
+		ProfileZone zone("AnimationManager::update");
+		// release animations that finished or were stopped since the last update
+		removed.clear();
+		for (auto& it : pools)
 		{
-			(*it)->step(delta);
-			if ((*it)->is_done())
-			{
-				it = animations.erase(it);
-			}
-			else
-			{
-				++it;
-			}
+			it.second->sweep(removed);
+		}
+		for (auto anim : removed)
+		{
+			animations.erase(anim);
+		}
+
+		completed.clear();
+		for (auto& it : pools)
+		{
+			it.second->step(delta, completed);
+		}
+		for (auto anim : completed)
+		{
+			anim->complete();
+		}
+	}
+
+	void AnimationManager::clear(void)
+	{
+		for (auto& it : animations)
+		{
+			it.second->stop();
 		}
 	}
-}
\ No newline at end of file
+}
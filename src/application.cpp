@@ -3,6 +3,7 @@
 #include <dukat/audiomanager.h>
 #include <dukat/log.h>
 #include <dukat/perfcounter.h>
+#include <dukat/profiler.h>
 #include <dukat/sysutil.h>
 #include <dukat/window.h>
 #include <dukat/devicemanager.h>
@@ -40,6 +41,11 @@ namespace dukat
 		device_manager = std::make_unique<DeviceManager>(settings);
 		device_manager->add_keyboard(window.get());
 		gl_check_error();
+
+		if (settings.get_bool("engine.profiler"))
+		{
+			profiler.start();
+		}
 	}
 
 	Application::~Application(void)
@@ -56,6 +62,7 @@ namespace dukat
 		SDL_Event e;
 		while (!done)
 		{
+			ProfileZone zone("Application::run");
 			ticks = SDL_GetTicks();
 
 			device_manager->update();
@@ -87,6 +94,11 @@ namespace dukat
 			perfc.reset();
 		}
 
+		if (profiler.is_recording())
+		{
+			profiler.save(settings.get_string("engine.profiler.file", "profile.json"));
+		}
+
 		return 0;
 	}
 
@@ -132,6 +144,23 @@ namespace dukat
 				save_screenshot(ss.str());
 			}
 			break;
+		case SDLK_F12:
+			toggle_profiler();
+			break;
+		}
+	}
+
+	void Application::toggle_profiler(void)
+	{
+		if (profiler.is_recording())
+		{
+			profiler.stop();
+			profiler.save(settings.get_string("engine.profiler.file", "profile.json"));
+		}
+		else
+		{
+			log->info("Recording profile.");
+			profiler.start();
 		}
 	}
 
@@ -8,6 +8,7 @@
 #include <dukat/meshbuilder2.h>
 #include <dukat/perfcounter.h>
 #include <dukat/plane.h>
+#include <dukat/profiler.h>
 #include <dukat/renderer.h>
 #include <dukat/shadercache.h>
 #include <dukat/vertextypes3.h>
@@ -309,6 +310,7 @@ namespace dukat
 
     void ClipMap::update(float delta)
     {
+        ProfileZone zone("ClipMap::update");
         // determine height of observer and set min_level accordingly
 		auto height = height_map->get_scale_factor() * height_map->get_elevation((int)std::round(observer_pos.x), (int)std::round(observer_pos.z), 0);
 		min_level = 0;
@@ -325,6 +327,7 @@ namespace dukat
 
     void ClipMap::update_levels(void)
     {
+        ProfileZone zone("ClipMap::update_levels");
         // Check if we meed to update the origin of the most fine-grained level.
         const uint8_t down = 1;
         const uint8_t up = 2;
@@ -431,6 +434,7 @@ namespace dukat
 
     int ClipMap::update_elevation_maps(void)
     {
+        ProfileZone zone("ClipMap::update_elevation_maps");
         bool fbo_bound = false;
         int max_index = -1;
 
@@ -599,6 +603,7 @@ namespace dukat
 
     void ClipMap::update_normal_maps(int max_index)
     {
+        ProfileZone zone("ClipMap::update_normal_maps");
         if (max_index < 0)
             return;
 
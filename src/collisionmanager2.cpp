@@ -1,13 +1,196 @@
 #include "stdafx.h"
 #include <dukat/collisionmanager2.h>
 #include <dukat/debugeffect2.h>
+#include <dukat/eventqueue.h>
+#include <dukat/gamebase.h>
 #include <dukat/log.h>
+#include <dukat/profiler.h>
+#include <dukat/workerpool.h>
 
 namespace dukat
 {
-	static std::vector<CollisionManager2::Body*> candidates;
+	void CollisionManager2::Body::set_oriented_box(const Vector2& center, const Vector2& extent, float angle)
+	{
+		shape = ORIENTED_BOX;
+		this->extent = extent;
+		axis = Vector2{ std::cos(angle), std::sin(angle) };
+		// project extent onto world axes to find enclosing box
+		const Vector2 half{ std::abs(axis.x) * extent.x + std::abs(axis.y) * extent.y,
+			std::abs(axis.y) * extent.x + std::abs(axis.x) * extent.y };
+		bb = AABB2{ center - half, center + half };
+	}
+
+	void CollisionManager2::Body::set_circle(const Vector2& center, float radius)
+	{
+		shape = CIRCLE;
+		this->radius = radius;
+		bb = AABB2{ center - Vector2{ radius, radius }, center + Vector2{ radius, radius } };
+	}
+
+	bool CollisionManager2::Body::contains(const Vector2& p) const
+	{
+		switch (shape)
+		{
+		case ORIENTED_BOX:
+		{
+			const auto d = p - bb.center();
+			const Vector2 y_axis{ -axis.y, axis.x };
+			return std::abs(d * axis) <= extent.x && std::abs(d * y_axis) <= extent.y;
+		}
+		case CIRCLE:
+			return (p - bb.center()).mag2() <= radius * radius;
+		default:
+			return bb.contains(p);
+		}
+	}
+
+	// Box shapes are tested in terms of their center, axes and half size.
+	struct ShapeBox
+	{
+		Vector2 center;
+		Vector2 axis[2];
+		Vector2 extent;
+	};
+
+	static ShapeBox to_box(const CollisionManager2::Body* b)
+	{
+		ShapeBox box;
+		box.center = b->bb.center();
+		if (b->shape == CollisionManager2::Body::ORIENTED_BOX)
+		{
+			box.axis[0] = b->axis;
+			box.axis[1] = Vector2{ -b->axis.y, b->axis.x };
+			box.extent = b->extent;
+		}
+		else
+		{
+			box.axis[0] = Vector2{ 1.0f, 0.0f };
+			box.axis[1] = Vector2{ 0.0f, 1.0f };
+			box.extent = (b->bb.max - b->bb.min) * 0.5f;
+		}
+		return box;
+	}
+
+	// Returns half the length of a box projected onto an axis.
+	static float project_box(const ShapeBox& box, const Vector2& axis)
+	{
+		return box.extent.x * std::abs(box.axis[0] * axis) + box.extent.y * std::abs(box.axis[1] * axis);
+	}
+
+	static bool test_aabb_aabb(const CollisionManager2::Body* b1, const CollisionManager2::Body* b2, Collision& collision)
+	{
+		return b1->bb.intersect(b2->bb, collision);
+	}
+
+	// Separating axis test for two boxes, at least one of them oriented.
+	static bool test_box_box(const CollisionManager2::Body* b1, const CollisionManager2::Body* b2, Collision& collision)
+	{
+		const auto box1 = to_box(b1);
+		const auto box2 = to_box(b2);
+		const auto d = box1.center - box2.center;
+		const Vector2 axes[4] = { box1.axis[0], box1.axis[1], box2.axis[0], box2.axis[1] };
+		auto min_overlap = big_number;
+		Vector2 min_axis;
+		for (const auto& a : axes)
+		{
+			const auto overlap = project_box(box1, a) + project_box(box2, a) - std::abs(d * a);
+			if (overlap <= 0.0f)
+				return false; // found separating axis
+			if (overlap < min_overlap)
+			{
+				min_overlap = overlap;
+				min_axis = a;
+			}
+		}
+
+		// separate along axis of least overlap, pointing from b2 to b1
+		if (d * min_axis < 0.0f)
+			min_axis = -min_axis;
+		collision.delta = min_axis * min_overlap;
+		collision.normal = min_axis;
+		collision.pos = box1.center - min_axis * project_box(box1, min_axis);
+		return true;
+	}
+
+	static bool test_box_circle(const CollisionManager2::Body* b1, const CollisionManager2::Body* b2, Collision& collision)
+	{
+		const auto box = to_box(b1);
+		const auto c = b2->bb.center();
+		const auto d = c - box.center;
+		// closest point on box to circle center, in box space
+		const Vector2 local{ d * box.axis[0], d * box.axis[1] };
+		auto closest = local;
+		clamp(closest.x, -box.extent.x, box.extent.x);
+		clamp(closest.y, -box.extent.y, box.extent.y);
+		auto diff = local - closest;
+		const auto dist2 = diff.mag2();
+		if (dist2 >= b2->radius * b2->radius)
+			return false;
+
+		Vector2 n;
+		float depth;
+		if (dist2 > 0.0f)
+		{
+			const auto dist = std::sqrt(dist2);
+			n = diff / dist;
+			depth = b2->radius - dist;
+		}
+		// circle center is inside of box - push out along closest edge
+		else if (box.extent.x - std::abs(local.x) < box.extent.y - std::abs(local.y))
+		{
+			n = Vector2{ local.x < 0.0f ? -1.0f : 1.0f, 0.0f };
+			depth = box.extent.x - std::abs(local.x) + b2->radius;
+		}
+		else
+		{
+			n = Vector2{ 0.0f, local.y < 0.0f ? -1.0f : 1.0f };
+			depth = box.extent.y - std::abs(local.y) + b2->radius;
+		}
+
+		// n points from box toward circle; normal points from b2 to b1
+		const auto world_n = box.axis[0] * n.x + box.axis[1] * n.y;
+		collision.normal = -world_n;
+		collision.delta = -world_n * depth;
+		collision.pos = box.center + box.axis[0] * closest.x + box.axis[1] * closest.y;
+		return true;
+	}
+
+	static bool test_circle_box(const CollisionManager2::Body* b1, const CollisionManager2::Body* b2, Collision& collision)
+	{
+		if (!test_box_circle(b2, b1, collision))
+			return false;
+		collision.normal = -collision.normal;
+		collision.delta = -collision.delta;
+		return true;
+	}
+
+	static bool test_circle_circle(const CollisionManager2::Body* b1, const CollisionManager2::Body* b2, Collision& collision)
+	{
+		const auto d = b1->bb.center() - b2->bb.center();
+		const auto r = b1->radius + b2->radius;
+		const auto dist2 = d.mag2();
+		if (dist2 >= r * r)
+			return false;
+
+		const auto dist = std::sqrt(dist2);
+		const auto n = dist > small_number ? d / dist : Vector2{ 1.0f, 0.0f };
+		collision.normal = n;
+		collision.delta = n * (r - dist);
+		collision.pos = b1->bb.center() - n * b1->radius;
+		return true;
+	}
+
+	using ShapeTest = bool(*)(const CollisionManager2::Body*, const CollisionManager2::Body*, Collision&);
+
+	// Intersection tests indexed by [b1->shape][b2->shape].
+	static const ShapeTest shape_tests[3][3] = {
+		{ test_aabb_aabb, test_box_box, test_box_circle },		// BOX
+		{ test_box_box, test_box_box, test_box_circle },		// ORIENTED_BOX
+		{ test_circle_box, test_circle_box, test_circle_circle }	// CIRCLE
+	};
 
-	CollisionManager2::CollisionManager2(GameBase* game) : Manager(game), 
+	CollisionManager2::CollisionManager2(GameBase* game) : Manager(game), broad_phase(QUAD_TREE), sleep_frames(0), mask_pruning(false),
+		worker_pool(game != nullptr ? game->get_worker_pool() : nullptr),
 		world_origin({ 0,0 }), world_size(1000.0f), world_depth(5), generation(0)
 	{
 		create_tree();
@@ -15,151 +198,669 @@ namespace dukat
 
 	CollisionManager2::Body* CollisionManager2::create_body(bool dynamic)
 	{
-		static uint16_t last_id = 0;
-		auto body = std::make_unique<Body>(last_id++);
+		static uint32_t last_id = 0;
+		auto body = body_pool.create(last_id++);
 		body->dynamic = dynamic;
-		bodies.push_back(std::move(body));
-		return bodies.back().get();
+		body->index = static_cast<uint32_t>(bodies.size());
+		bodies.push_back(body);
+		if (broad_phase == SWEEP_AND_PRUNE)
+		{
+			body->sweep_index = static_cast<uint32_t>(sweep.size());
+			sweep.push_back(SweepEntry{ body->bb.min, body->bb.max, body, false, dynamic });
+		}
+		return body;
+	}
+
+	void CollisionManager2::set_broad_phase(BroadPhase broad_phase)
+	{
+		if (this->broad_phase == broad_phase)
+			return;
+		this->broad_phase = broad_phase;
+		// drop tree contents; bodies will be re-inserted once trees are used again
+		create_tree();
+		// sweep entries are only maintained while in use
+		sweep.clear();
+		if (broad_phase == SWEEP_AND_PRUNE)
+		{
+			for (auto b : bodies)
+			{
+				b->sweep_index = static_cast<uint32_t>(sweep.size());
+				sweep.push_back(SweepEntry{ b->bb.min, b->bb.max, b, false, b->dynamic });
+			}
+		}
+	}
+
+	void CollisionManager2::set_mask_pruning(bool mask_pruning)
+	{
+		this->mask_pruning = mask_pruning;
+		if (!mask_pruning)
+		{
+			// masks are no longer maintained, so let them match anything
+			static_tree->reset_mask();
+			dynamic_tree->reset_mask();
+		}
 	}
 
 	void CollisionManager2::destroy_body(Body* body)
 	{
+		// Handlers run below may destroy this body as well; the outer call releases it.
+		if (body->destroying)
+			return;
+		body->destroying = true;
+
+		// Deliver pending events that refer to this body while it is still valid,
+		// and drop those for its owner, which can no longer be reached.
+		for (auto& e : events)
+		{
+			if (e.body == body)
+			{
+				e.body = nullptr;
+			}
+			else if (e.body != nullptr && e.other == body)
+			{
+				const auto pending = e;
+				e.body = nullptr;
+				trigger_event(pending);
+			}
+		}
+		// Messages queued in deferred mode carry the body as param1 without a copy
+		auto queue = game != nullptr ? game->get_event_queue() : nullptr;
+		if (queue != nullptr)
+			queue->dispatch_param(body);
+
 		// Remove any contacts this body is part of
-		for (const auto& c : get_contacts(body))
+		while (body->first_contact != no_contact)
 		{
-			auto other_body = c->body1 == body ? c->body2 : c->body1;
+			const auto index = body->first_contact;
+			const auto& c = contacts[index];
+			auto other_body = c.body1 == body ? c.body2 : c.body1;
+			remove_contact(index);
 			if (other_body->owner != nullptr)
 			{
-				other_body->owner->trigger(Message{ Events::CollisionEnd, body });
+				// delivered right away, as body is released before the queue is flushed
+				other_body->owner->dispatch(Message{ Events::CollisionEnd, body });
 			}
-			contacts.erase(hash(c->body1, c->body2));
 		}
 
-		auto it = std::find_if(bodies.begin(), bodies.end(), 
-			[body](const std::unique_ptr<Body>& b) { return body == b.get(); });
-		if (it != bodies.end())
+		remove_node(body);
+		// sweep entries are kept sorted, so the entry is dropped during the next update
+		if (broad_phase == SWEEP_AND_PRUNE)
+			sweep[body->sweep_index].body = nullptr;
+
+		// fill the gap with the last body
+		auto last = bodies.back();
+		bodies[body->index] = last;
+		last->index = body->index;
+		bodies.pop_back();
+		body_pool.destroy(body);
+	}
+
+	void CollisionManager2::wake(Body* body)
+	{
+		body->still_frames = 0;
+		body->asleep = false;
+	}
+
+	void CollisionManager2::wake_touched(Body* body)
+	{
+		wake(body);
+		// Contacts with other resting bodies were not tested during this update, 
+		// but are still valid - keep them alive until the next update.
+		for_each_contact(body, [&](Contact& c) {
+			if (is_resting(c.body1 == body ? c.body2 : c.body1))
+				c.generation = generation;
+		});
+	}
+
+	void CollisionManager2::update_sleep(void)
+	{
+		ProfileZone zone("CollisionManager2::update_sleep");
+		auto awake = 0;
+		auto asleep = 0;
+		for (const auto& b : bodies)
+		{
+			if (!b->active || !b->dynamic || sleep_frames <= 0)
+			{
+				b->asleep = false;
+				b->still_frames = 0;
+				continue;
+			}
+
+			if (b->bb.min != b->last_bb.min || b->bb.max != b->last_bb.max)
+			{
+				wake(b);
+			}
+			else if (!b->asleep && ++b->still_frames >= sleep_frames)
+			{
+				b->asleep = true;
+			}
+
+			if (b->asleep)
+				asleep++;
+			else
+				awake++;
+		}
+		perfc.inc(PerformanceCounter::BODIES_AWAKE, awake);
+		perfc.inc(PerformanceCounter::BODIES_ASLEEP, asleep);
+	}
+
+	void CollisionManager2::update_node(Body* body)
+	{
+		if (!body->active)
+		{
+			remove_node(body);
+			return;
+		}
+		// sleeping bodies have not moved, so they stay in their node unless the trees were rebuilt
+		if (body->asleep && body->node != nullptr)
+			return;
+
+		// body was switched between static and dynamic since last frame
+		if (body->node != nullptr && body->node_dynamic != body->dynamic)
+		{
+			remove_node(body);
+		}
+
+		if (body->node == nullptr)
 		{
-			bodies.erase(it);
+			body->node = (body->dynamic ? dynamic_tree : static_tree)->insert(body);
+			body->node_dynamic = body->dynamic;
+		}
+		else
+		{
+			// only re-buckets the body if it moved out of its current node
+			body->node = body->node->relocate(body);
+		}
+	}
+
+	void CollisionManager2::remove_node(Body* body)
+	{
+		if (body->node != nullptr)
+		{
+			body->node->remove(body);
+			body->node = nullptr;
 		}
 	}
 
-	void CollisionManager2::find_collisions(const QuadTree<Body>& t, Body* body, std::vector<Body*>& res) const
+	void CollisionManager2::find_collisions(const QuadTree<Body>& t, Body* body, std::vector<Body*>& res, uint32_t filter) const
 	{
+		if ((t.get_mask() & filter) == 0)
+			return;
 		auto idx = t.get_index(body);
 		if (idx > -1 && t.has_child(idx))
 		{
-			find_collisions(*t.child(idx), body, res);
+			find_collisions(*t.child(idx), body, res, filter);
 		}
 		const auto& values = t.get_values();
 		res.insert(res.end(), values.begin(), values.end());
 	}
 
+	uint32_t CollisionManager2::find_contact(const Body* b1, const Body* b2) const
+	{
+		// walk the shorter of the two contact lists
+		if (b2->contact_degree < b1->contact_degree)
+			std::swap(b1, b2);
+		auto index = b1->first_contact;
+		while (index != no_contact)
+		{
+			const auto& c = contacts[index];
+			if (c.body1 == b2 || c.body2 == b2)
+				return index;
+			index = c.next[contact_slot(c, b1)];
+		}
+		return no_contact;
+	}
+
+	uint32_t CollisionManager2::add_contact(Body* b1, Body* b2)
+	{
+		uint32_t index;
+		if (free_contacts.empty())
+		{
+			index = static_cast<uint32_t>(contacts.size());
+			contacts.emplace_back();
+		}
+		else
+		{
+			index = free_contacts.back();
+			free_contacts.pop_back();
+			contacts[index] = Contact{};
+		}
+
+		auto& c = contacts[index];
+		c.body1 = b1;
+		c.body2 = b2;
+		// push contact to the front of both body lists
+		Body* pair[2] = { b1, b2 };
+		for (auto slot = 0; slot < 2; slot++)
+		{
+			auto b = pair[slot];
+			c.next[slot] = b->first_contact;
+			if (b->first_contact != no_contact)
+			{
+				auto& head = contacts[b->first_contact];
+				head.prev[contact_slot(head, b)] = index;
+			}
+			b->first_contact = index;
+			b->contact_degree++;
+		}
+		return index;
+	}
+
+	void CollisionManager2::remove_contact(uint32_t index)
+	{
+		auto& c = contacts[index];
+		Body* pair[2] = { c.body1, c.body2 };
+		for (auto slot = 0; slot < 2; slot++)
+		{
+			auto b = pair[slot];
+			if (c.prev[slot] != no_contact)
+			{
+				auto& prev = contacts[c.prev[slot]];
+				prev.next[contact_slot(prev, b)] = c.next[slot];
+			}
+			else
+			{
+				b->first_contact = c.next[slot];
+			}
+			if (c.next[slot] != no_contact)
+			{
+				auto& next = contacts[c.next[slot]];
+				next.prev[contact_slot(next, b)] = c.prev[slot];
+			}
+			b->contact_degree--;
+		}
+		c.body1 = c.body2 = nullptr;
+		free_contacts.push_back(index);
+	}
+
 	void CollisionManager2::resolve_collisions(void)
 	{
-		for (auto it = contacts.begin(); it != contacts.end(); )
+		ProfileZone zone("CollisionManager2::resolve_collisions");
+		for (auto index = 0u; index < contacts.size(); index++)
 		{
+			auto& c = contacts[index];
+			if (c.body1 == nullptr)
+				continue; // unused slot
+
+			// contacts of sleeping bodies with other bodies that are not moving are kept as they are
+			if ((c.body1->asleep || c.body2->asleep) && is_resting(c.body1) && is_resting(c.body2))
+				continue;
+
 			// clean up contacts which are no longer active
-			if (it->second.generation != generation)
+			if (c.generation != generation)
 			{
-				if (it->second.body1->owner != nullptr)
-					it->second.body1->owner->trigger(Message{ Events::CollisionEnd, it->second.body2 });
-				if (it->second.body2->owner != nullptr)
-					it->second.body2->owner->trigger(Message{ Events::CollisionEnd, it->second.body1 });
-				it = contacts.erase(it);
+				auto b1 = c.body1;
+				auto b2 = c.body2;
+				remove_contact(index);
+				events.push_back(PendingEvent{ b1, Events::CollisionEnd, b2 });
+				events.push_back(PendingEvent{ b2, Events::CollisionEnd, b1 });
 			}
 			// attempt to resolve active contacts
 			else
 			{
-				auto b1 = it->second.body1;
-				auto b2 = it->second.body2;
+				auto b1 = c.body1;
+				auto b2 = c.body2;
 				if (b1->solid && b2->solid)
 				{
-					auto shift = it->second.collision.delta;
+					auto shift = c.collision.delta;
 					if (b1->dynamic)
 					{
 						b1->bb.min += shift;
 						b1->bb.max += shift;
-						if (b1->owner != nullptr)
-							b1->owner->trigger(Message{ Events::CollisionResolve, &shift });
+						events.push_back(PendingEvent{ b1, Events::CollisionResolve, b2, Contact{}, shift });
 					}
 					if (b2->dynamic)
 					{
 						shift = -shift;
 						b2->bb.min += shift;
 						b2->bb.max += shift;
-						if (b2->owner != nullptr)
-							b2->owner->trigger(Message{ Events::CollisionResolve, &shift });
+						events.push_back(PendingEvent{ b2, Events::CollisionResolve, b1, Contact{}, shift });
 					}
 				}
+			}
+		}
+	}
 
-				++it;
+	void CollisionManager2::trigger_event(const PendingEvent& e) const
+	{
+		auto owner = e.body->owner;
+		if (owner == nullptr)
+			return;
+
+		switch (e.event)
+		{
+		case Events::CollisionBegin:
+			// contacts are copied into the queue in deferred mode
+			static_assert(sizeof(Contact) <= EventQueue::max_payload, "Contact must fit into an event queue entry.");
+			owner->trigger(Message{ e.event, e.other, &e.contact }, 0, sizeof(Contact));
+			break;
+		case Events::CollisionResolve:
+			owner->trigger(Message{ e.event, &e.shift }, sizeof(e.shift));
+			break;
+		default:
+			owner->trigger(Message{ e.event, e.other });
+			break;
+		}
+	}
+
+	void CollisionManager2::dispatch_events(void)
+	{
+		// handlers may destroy bodies, which drops or delivers the events
+		// that refer to them, but never adds new ones
+		for (const auto& e : events)
+		{
+			if (e.body != nullptr)
+				trigger_event(e);
+		}
+		events.clear();
+	}
+
+	void CollisionManager2::test_pairs(int first, int last, NarrowChunk& chunk) const
+	{
+		chunk.results.clear();
+		chunk.checks = 0;
+		for (auto i = first; i < last; i++)
+		{
+			auto this_body = pairs[i].first;
+			auto other_body = pairs[i].second;
+			chunk.checks++;
+			Collision collision;
+			auto toi = 1.0f;
+			auto hit = intersect(this_body, other_body, collision);
+			if (this_body->fast || other_body->fast)
+			{
+				const auto t = time_of_impact(this_body, other_body);
+				if (t != no_intersection)
+				{
+					// Bodies that came into contact during this frame are moved back to
+					// the point of impact, as they might have passed through each other.
+					// Swept tests use bounding boxes, so for other shapes they only
+					// catch bodies that passed through each other entirely.
+					const auto boxes = this_body->shape == Body::BOX && other_body->shape == Body::BOX;
+					if (t > 0.0f && (boxes || !hit))
+					{
+						hit = swept_collision(this_body, other_body, t, collision) || hit;
+					}
+					toi = std::max(0.0f, t);
+				}
+			}
+			if (hit)
+			{
+				chunk.results.push_back(NarrowResult{ this_body, other_body, find_contact(this_body, other_body), collision, toi });
 			}
 		}
 	}
 
-	void CollisionManager2::update(float delta)
+	void CollisionManager2::test_pairs(void)
 	{
-		// broad phase - determine all possible collisions
-		tree->clear();
-		for (const auto& b : bodies)
+		ProfileZone zone("CollisionManager2::test_pairs");
+		const auto pair_count = static_cast<int>(pairs.size());
+		auto num_chunks = 1;
+		if (worker_pool != nullptr)
+		{
+			// a few jobs per thread to even out uneven chunks
+			num_chunks = std::min(4 * worker_pool->thread_count(), (pair_count + min_chunk_size - 1) / min_chunk_size);
+			num_chunks = std::max(1, num_chunks);
+		}
+
+		if (static_cast<int>(chunks.size()) < num_chunks)
+			chunks.resize(num_chunks);
+		const auto chunk_size = (pair_count + num_chunks - 1) / num_chunks;
+		auto job = [&](int i) {
+			const auto first = std::min(pair_count, i * chunk_size);
+			const auto last = std::min(pair_count, first + chunk_size);
+			test_pairs(first, last, chunks[i]);
+		};
+
+		if (num_chunks > 1)
+		{
+			worker_pool->parallel_for(num_chunks, job);
+		}
+		else
+		{
+			job(0);
+		}
+
+		// chunks beyond num_chunks may hold results from an earlier frame
+		for (auto i = num_chunks; i < static_cast<int>(chunks.size()); i++)
+		{
+			chunks[i].results.clear();
+			chunks[i].checks = 0;
+		}
+	}
+
+	bool CollisionManager2::intersect(const Body* b1, const Body* b2, Collision& collision) const
+	{
+		// other shapes are only tested if their enclosing boxes overlap
+		if ((b1->shape != Body::BOX || b2->shape != Body::BOX) && !b1->bb.overlaps(b2->bb))
+			return false;
+		return shape_tests[b1->shape][b2->shape](b1, b2, collision);
+	}
+
+	float CollisionManager2::time_of_impact(const Body* b1, const Body* b2) const
+	{
+		if (b1->last_bb.empty() || b2->last_bb.empty())
+			return no_intersection;
+
+		// Sweep center of b1 relative to b2 against b2 grown by b1's extent
+		const auto d = (b1->bb.center() - b1->last_bb.center()) - (b2->bb.center() - b2->last_bb.center());
+		if (std::abs(d.x) < small_number && std::abs(d.y) < small_number)
+			return no_intersection;
+		const auto half_extent = (b1->bb.max - b1->bb.min) * 0.5f;
+		const AABB2 target{ b2->last_bb.min - half_extent, b2->last_bb.max + half_extent };
+		const Ray2 ray{ b1->last_bb.center(), d };
+		return target.intersect_ray(ray, 0.0f, 1.0f);
+	}
+
+	bool CollisionManager2::swept_collision(const Body* b1, const Body* b2, float toi, Collision& collision) const
+	{
+		const auto d1 = b1->bb.center() - b1->last_bb.center();
+		const auto d2 = b2->bb.center() - b2->last_bb.center();
+		const auto c1 = b1->last_bb.center() + d1 * toi;
+		const auto c2 = b2->last_bb.center() + d2 * toi;
+		const auto d = c1 - c2;
+		const auto rel = d1 - d2;
+		// at the time of impact, the boxes touch along the axis with least overlap
+		const auto p = ((b1->bb.max - b1->bb.min) + (b2->bb.max - b2->bb.min)) * 0.5f - d.abs();
+		if (p.x <= 0.0f && p.y <= 0.0f)
+			return false; // bodies only grazed each other
+
+		collision = Collision{};
+		const auto that_c = b2->bb.center();
+		if (p.x < p.y)
 		{
-			if (b->active)
+			auto sx = sgn(d.x);
+			collision.delta.x = -rel.x * (1.0f - toi);
+			collision.normal.x = static_cast<float>(sx);
+			collision.pos.x = sx < 0 ? b2->bb.min.x : b2->bb.max.x;
+			collision.pos.y = that_c.y;
+		}
+		else
+		{
+			auto sy = sgn(d.y);
+			collision.delta.y = -rel.y * (1.0f - toi);
+			collision.normal.y = static_cast<float>(sy);
+			collision.pos.x = that_c.x;
+			collision.pos.y = sy < 0 ? b2->bb.min.y : b2->bb.max.y;
+		}
+		return true;
+	}
+
+	void CollisionManager2::merge_contacts(void)
+	{
+		ProfileZone zone("CollisionManager2::merge_contacts");
+		// chunks cover consecutive ranges of pairs, so merging them in order
+		// yields the same contacts and events as testing all pairs serially
+		for (auto& chunk : chunks)
+		{
+			perfc.inc(PerformanceCounter::BB_CHECKS, chunk.checks);
+			for (const auto& r : chunk.results)
 			{
-				tree->insert(b.get());
+				// sleeping bodies wake up when touched
+				if (r.body1->asleep)
+					wake_touched(r.body1);
+				if (r.body2->asleep)
+					wake_touched(r.body2);
+
+				// Update contact if this is an existing collision
+				if (r.contact != no_contact)
+				{
+					auto& old_contact = contacts[r.contact];
+					old_contact.generation = generation;
+					old_contact.collision = r.collision;
+					old_contact.toi = r.toi;
+				}
+				// Otherwise, create a new contact
+				else
+				{
+					auto index = add_contact(r.body1, r.body2);
+					auto& c = contacts[index];
+					c.collision = r.collision;
+					c.generation = generation;
+					c.toi = r.toi;
+
+					events.push_back(PendingEvent{ r.body1, Events::CollisionBegin, r.body2, c });
+					events.push_back(PendingEvent{ r.body2, Events::CollisionBegin, r.body1, c });
+				}
 			}
 		}
+	}
+
+	void CollisionManager2::update_tree(void)
+	{
+		ProfileZone zone("CollisionManager2::update_tree");
+		// broad phase - keep trees in sync with body positions
+		for (const auto& b : bodies)
+		{
+			update_node(b);
+		}
+		if (mask_pruning)
+		{
+			auto category = [](const Body* b) { return b->category; };
+			static_tree->update_mask(category);
+			dynamic_tree->update_mask(category);
+		}
 
-		// narrow phase - build up set of actual collisions
+		// collect candidate pairs
+		pairs.clear();
 		for (const auto& b : bodies)
 		{
-			if (!b->active)
+			// static bodies do not collide with one another, so only
+			// dynamic bodies that are awake need to look for contacts
+			if (!b->active || !b->dynamic || b->asleep)
 				continue;
 
 			candidates.clear();
-			auto this_body = b.get();
-			find_collisions(*tree, this_body, candidates);
-			for (auto other_body : candidates)
+			auto this_body = b;
+			const auto filter = mask_pruning ? this_body->mask : 0xffffffff;
+			find_collisions(*dynamic_tree, this_body, candidates, filter);
+			static_tree->query(this_body, candidates, filter);
+			// Sleeping bodies below this body's node will not look for it themselves.
+			const auto first_sleeping = candidates.size();
+			if (sleep_frames > 0)
 			{
-				if (this_body == other_body)
+				for (auto i = 0; i < 4; i++)
+				{
+					if (this_body->node->has_child(i))
+						this_body->node->child(i)->query(this_body, candidates, filter);
+				}
+			}
+			for (auto i = 0u; i < candidates.size(); i++)
+			{
+				auto other_body = candidates[i];
+				if (i >= first_sleeping && !other_body->asleep)
 					continue;
-				if (!this_body->dynamic && !other_body->dynamic)
-					continue; // static bodies do not collide with one another
-
-				// Check if collision has already been detected during this frame
-				const auto id = hash(this_body, other_body);
-				const auto contact_exists = contacts.count(id) > 0;
-				if (contact_exists && contacts[id].generation == generation)
+				// Two awake dynamic bodies in the same node find each other - keep
+				// only the pair seen first, i.e. from the body created first.
+				if (this_body == other_body || (other_body->node == this_body->node && other_body->id < this_body->id && !other_body->asleep))
 					continue;
+				if (!can_collide(this_body, other_body))
+					continue;
+				pairs.push_back(std::make_pair(this_body, other_body));
+			}
+		}
+	}
 
-				perfc.inc(PerformanceCounter::BB_CHECKS);
-				Contact c;
-				if (this_body->bb.intersect(other_body->bb, c.collision))
-				{
-					// Update contact if this is an existing collision
-					if (contact_exists)
-					{
-						auto& old_contact = contacts[id];
-						old_contact.generation = generation;
-						old_contact.collision = c.collision;
-					}
-					// Otherwise, create a new contact
-					else
-					{
-						c.body1 = this_body;
-						c.body2 = other_body;
-						c.generation = generation;
-						contacts[id] = c;
-
-						if (c.body1->owner != nullptr)
-							c.body1->owner->trigger(Message{ Events::CollisionBegin, c.body2, &c });
-						if (c.body2->owner != nullptr)
-							c.body2->owner->trigger(Message{ Events::CollisionBegin, c.body1, &c });
-					}
-				}
+	void CollisionManager2::update_sweep(void)
+	{
+		ProfileZone zone("CollisionManager2::update_sweep");
+		// drop entries of destroyed bodies
+		sweep.erase(std::remove_if(sweep.begin(), sweep.end(), [](const SweepEntry& e) { return e.body == nullptr; }), sweep.end());
+		for (auto& e : sweep)
+		{
+			const auto bb = e.body->swept_bb();
+			e.min = bb.min;
+			e.max = bb.max;
+			e.active = e.body->active;
+			e.awake = e.body->dynamic && !e.body->asleep;
+		}
+
+		// Insertion sort by min.x - bodies only move a little between frames,
+		// so the list is nearly sorted and this runs in close to linear time.
+		for (auto i = 1u; i < sweep.size(); i++)
+		{
+			auto e = sweep[i];
+			auto j = i;
+			while (j > 0 && sweep[j - 1].min.x > e.min.x)
+			{
+				sweep[j] = sweep[j - 1];
+				j--;
 			}
+			sweep[j] = e;
 		}
+		for (auto i = 0u; i < sweep.size(); i++)
+		{
+			sweep[i].body->sweep_index = i;
+		}
+
+		pairs.clear();
+		for (auto i = 0u; i < sweep.size(); i++)
+		{
+			const auto& e1 = sweep[i];
+			if (!e1.active)
+				continue;
+			// only bodies starting before e1 ends can overlap it on the x-axis
+			for (auto j = i + 1; j < sweep.size() && sweep[j].min.x <= e1.max.x; j++)
+			{
+				const auto& e2 = sweep[j];
+				if (!e2.active || (!e1.awake && !e2.awake))
+					continue; // static or sleeping bodies do not collide with one another
+				if (e1.max.y < e2.min.y || e1.min.y > e2.max.y)
+					continue;
+				if (!can_collide(e1.body, e2.body))
+					continue;
+				pairs.push_back(std::make_pair(e1.body, e2.body));
+			}
+		}
+	}
+
+	void CollisionManager2::update(float delta)
+	{
+		ProfileZone zone("CollisionManager2::update");
+		update_sleep();
+
+		// broad phase
+		if (broad_phase == SWEEP_AND_PRUNE)
+		{
+			update_sweep();
+		}
+		else
+		{
+			update_tree();
+		}
+
+		// narrow phase
+		test_pairs();
+		merge_contacts();
 
 		resolve_collisions();
+		dispatch_events();
+
+		// remember positions for swept tests during next update
+		for (auto& b : bodies)
+		{
+			b->last_bb = b->bb;
+		}
 
 		generation++;
 	}
@@ -167,31 +868,45 @@ namespace dukat
 	void CollisionManager2::create_tree(void)
 	{
 		Vector2 dim{ 0.5f * world_size, 0.5f * world_size };
-		tree = std::make_unique<QuadTree<Body>>(world_origin - dim, world_origin + dim, world_depth);
+		static_tree = std::make_unique<QuadTree<Body>>(world_origin - dim, world_origin + dim, world_depth);
+		dynamic_tree = std::make_unique<QuadTree<Body>>(world_origin - dim, world_origin + dim, world_depth);
+		// bodies will be re-inserted during next update
+		for (auto& b : bodies)
+		{
+			b->node = nullptr;
+		}
 	}
 
-	std::list<CollisionManager2::Contact*> CollisionManager2::get_contacts(Body* b) const
+	std::list<CollisionManager2::Contact*> CollisionManager2::get_contacts(Body* b)
 	{
 		std::list<Contact*> res;
-		for (const auto& it : contacts)
-		{
-			if (it.second.body1 == b || it.second.body2 == b)
-				res.push_back(const_cast<Contact*>(&it.second));
-		}
+		for_each_contact(b, [&res](Contact& c) { res.push_back(&c); });
 		return res;
 	}
 
 	std::list<CollisionManager2::Body*> CollisionManager2::get_bodies(const Vector2& p) const
 	{
+		if (broad_phase == SWEEP_AND_PRUNE)
+		{
+			std::list<Body*> res;
+			for (auto b : bodies)
+			{
+				if (b->active && b->contains(p))
+					res.push_back(b);
+			}
+			return res;
+		}
+
 		Body b{ 0 };
 		b.bb.min = b.bb.max = p;
-		candidates.clear();
-		find_collisions(*tree, &b, candidates);
+		std::vector<Body*> found;
+		find_collisions(*static_tree, &b, found);
+		find_collisions(*dynamic_tree, &b, found);
 
 		std::list<Body*> res;
-		for (Body* b : candidates)
+		for (Body* b : found)
 		{
-			if (b->bb.contains(p))
+			if (b->contains(p))
 			{
 				res.push_back(b);
 			}
@@ -199,4 +914,151 @@ namespace dukat
 
 		return res;
 	}
+
+	// Returns the squared distance between a point and a box.
+	static float distance2(const Vector2& p, const Vector2& min, const Vector2& max)
+	{
+		const auto dx = std::max(0.0f, std::max(min.x - p.x, p.x - max.x));
+		const auto dy = std::max(0.0f, std::max(min.y - p.y, p.y - max.y));
+		return dx * dx + dy * dy;
+	}
+
+	template<typename F>
+	void CollisionManager2::run_queries(int count, const F& fn) const
+	{
+		if (worker_pool == nullptr || count < 2 * min_query_chunk)
+		{
+			for (auto i = 0; i < count; i++)
+			{
+				fn(i);
+			}
+			return;
+		}
+
+		const auto num_jobs = std::min(4 * worker_pool->thread_count(), count / min_query_chunk);
+		// Jobs only capture a pointer, so the std::function taken by
+		// parallel_for is stored without allocating.
+		struct QueryJobs
+		{
+			const F* fn;
+			int count;
+			int chunk_size;
+		} jobs{ &fn, count, (count + num_jobs - 1) / num_jobs };
+		const auto ctx = &jobs;
+		worker_pool->parallel_for(num_jobs, [ctx](int job) {
+			const auto last = std::min(ctx->count, (job + 1) * ctx->chunk_size);
+			for (auto i = job * ctx->chunk_size; i < last; i++)
+			{
+				(*ctx->fn)(i);
+			}
+		});
+	}
+
+	template<typename P, typename F>
+	void CollisionManager2::visit_bodies(uint32_t mask, const P& pred, const F& fn) const
+	{
+		if (broad_phase == SWEEP_AND_PRUNE)
+		{
+			// no tree to narrow down the search
+			for (auto b : bodies)
+			{
+				if (b->active && (b->category & mask) != 0)
+					fn(b);
+			}
+			return;
+		}
+
+		auto node_pred = [&](const Vector2& min, const Vector2& max, uint32_t node_mask) {
+			return (!mask_pruning || (node_mask & mask) != 0) && pred(min, max);
+		};
+		auto body_fn = [&](Body* b) {
+			if ((b->category & mask) != 0)
+				fn(b);
+		};
+		static_tree->visit(node_pred, body_fn);
+		dynamic_tree->visit(node_pred, body_fn);
+	}
+
+	int CollisionManager2::query_area(const AABB2& box, uint32_t mask, Body** res, int max_results) const
+	{
+		auto count = 0;
+		visit_bodies(mask, [&](const Vector2& min, const Vector2& max) {
+			return count < max_results && box.overlaps(AABB2{ min, max });
+		}, [&](Body* b) {
+			if (count < max_results && box.overlaps(b->bb))
+				res[count++] = b;
+		});
+		return count;
+	}
+
+	CollisionManager2::RayHit CollisionManager2::query_ray(const Ray2& ray, float far, uint32_t mask) const
+	{
+		RayHit hit{ nullptr, far };
+		visit_bodies(mask, [&](const Vector2& min, const Vector2& max) {
+			return AABB2{ min, max }.intersect_ray(ray, 0.0f, hit.t) != no_intersection;
+		}, [&](Body* b) {
+			auto t = b->bb.intersect_ray(ray, 0.0f, hit.t);
+			if (t == no_intersection)
+				return;
+			t = std::max(0.0f, t); // ray starts inside of body
+			if (hit.body == nullptr || t < hit.t)
+			{
+				hit.body = b;
+				hit.t = t;
+			}
+		});
+		return hit;
+	}
+
+	int CollisionManager2::query_nearest(const Vector2& p, int k, uint32_t mask, Body** res) const
+	{
+		// res is kept sorted by distance, so the last entry is the furthest
+		auto count = 0;
+		visit_bodies(mask, [&](const Vector2& min, const Vector2& max) {
+			return count < k || distance2(p, min, max) < distance2(p, res[count - 1]->bb.min, res[count - 1]->bb.max);
+		}, [&](Body* b) {
+			const auto d = distance2(p, b->bb.min, b->bb.max);
+			auto i = count;
+			if (count < k)
+				count++;
+			else if (d >= distance2(p, res[k - 1]->bb.min, res[k - 1]->bb.max))
+				return;
+			else
+				i = k - 1;
+			// insertion step
+			while (i > 0 && distance2(p, res[i - 1]->bb.min, res[i - 1]->bb.max) > d)
+			{
+				res[i] = res[i - 1];
+				i--;
+			}
+			res[i] = b;
+		});
+		return count;
+	}
+
+	void CollisionManager2::query_area(const AABB2* boxes, int count, uint32_t mask, Body** res, int max_results, int* counts) const
+	{
+		run_queries(count, [&](int i) {
+			counts[i] = query_area(boxes[i], mask, res + i * max_results, max_results);
+		});
+	}
+
+	void CollisionManager2::query_ray(const Ray2* rays, int count, float far, uint32_t mask, RayHit* hits) const
+	{
+		run_queries(count, [&](int i) {
+			hits[i] = query_ray(rays[i], far, mask);
+		});
+	}
+
+	void CollisionManager2::query_nearest(const Vector2* points, int count, int k, uint32_t mask, Body** res, int* counts) const
+	{
+		if (k <= 0)
+		{
+			std::fill(counts, counts + count, 0);
+			return;
+		}
+		run_queries(count, [&](int i) {
+			counts[i] = query_nearest(points[i], k, mask, res + i * k);
+		});
+	}
 }
\ No newline at end of file
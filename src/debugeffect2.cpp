@@ -55,6 +55,57 @@ namespace dukat
 		mesh->render(program);
 	}
 
+	void DebugEffect2::render_body(const CollisionManager2::Body* body, const Color& color) const
+	{
+		switch (body->shape)
+		{
+		case CollisionManager2::Body::ORIENTED_BOX:
+		{
+			const auto c = body->bb.center();
+			const auto x = body->axis * body->extent.x;
+			const auto y = Vector2{ -body->axis.y, body->axis.x } * body->extent.y;
+			const Vector2 corners[4] = { c - x - y, c + x - y, c + x + y, c - x + y };
+			program->set(Renderer::uf_color, color.r, color.g, color.b, color.a);
+			buffer.resize(4);
+			for (auto i = 0; i < 4; i++)
+			{
+				buffer[i].px = corners[i].x * scale;
+				buffer[i].py = corners[i].y * scale;
+			}
+			mesh->set_vertices(buffer.data(), 4);
+			mesh->render(program);
+			break;
+		}
+		case CollisionManager2::Body::CIRCLE:
+			render_circle(body->bb.center(), body->radius, color);
+			break;
+		default:
+			render_bounding_box(body->bb, color);
+			break;
+		}
+	}
+
+	void DebugEffect2::render_tree(QuadTree<CollisionManager2::Body>* tree, const AABB2& world_bb, const Color& color) const
+	{
+		std::queue<QuadTree<CollisionManager2::Body>*> queue;
+		queue.push(tree);
+
+		while (!queue.empty())
+		{
+			auto t = queue.front();
+			queue.pop();
+
+			for (auto i = 0; i < 4; i++)
+			{
+				if (t->has_child(i))
+					queue.push(t->child(i));
+			}
+
+			if (world_bb.contains(t->min) || world_bb.contains(t->max))
+				render_rect(t->min, t->max, color);
+		}
+	}
+
 	void DebugEffect2::render(Renderer2* renderer, const AABB2& camera_bb)
 	{
 		renderer->switch_shader(program);
@@ -65,24 +116,10 @@ namespace dukat
 
 		if ((flags & Flags::GRID) == Flags::GRID)
 		{
-			Color tree_color{ 0.0f, 0.0f, 1.0f, 1.0f };
-			std::queue<QuadTree<CollisionManager2::Body>*> queue;
-			queue.push(cm->tree.get());
-
-			while (!queue.empty())
-			{
-				auto t = queue.front();
-				queue.pop();
-
-				for (auto i = 0; i < 4; i++)
-				{
-					if (t->has_child(i))
-						queue.push(t->child(i));
-				}
-
-				if (world_bb.contains(t->min) || world_bb.contains(t->max))
-					render_rect(t->min, t->max, tree_color);
-			}
+			Color static_color{ 0.0f, 0.0f, 0.5f, 1.0f };
+			Color dynamic_color{ 0.0f, 0.0f, 1.0f, 1.0f };
+			render_tree(cm->static_tree.get(), world_bb, static_color);
+			render_tree(cm->dynamic_tree.get(), world_bb, dynamic_color);
 		}
 
 		if ((flags & Flags::BODIES) == Flags::BODIES)
@@ -91,26 +128,26 @@ namespace dukat
 			Color dynamic_color{ 1.0f, 1.0f, 1.0f, 1.0f };
 			Color sensor_color{ 1.0f, 1.0f, 0.0f, 1.0f };
 			Color contact_color{ 1.0f, 0.0f, 0.0f, 0.8f };
-			for (const auto& b : cm->bodies)
+			for (auto b : cm->bodies)
 			{
 				if (!world_bb.overlaps(b->bb))
 					continue;
 
 				if (!b->dynamic)
 				{
-					render_bounding_box(b->bb, fixed_color);
+					render_body(b, fixed_color);
 				}
-				else if (!cm->get_contacts(b.get()).empty())
+				else if (cm->contact_count(b) > 0)
 				{
-					render_bounding_box(b->bb, contact_color);
+					render_body(b, contact_color);
 				}
 				else if (b->solid)
 				{
-					render_bounding_box(b->bb, dynamic_color);
+					render_body(b, dynamic_color);
 				}
 				else
 				{
-					render_bounding_box(b->bb, sensor_color);
+					render_body(b, sensor_color);
 				}
 			}
 		}
@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include <dukat/eventqueue.h>
+#include <dukat/log.h>
+#include <dukat/messenger.h>
+#include <dukat/profiler.h>
+
+namespace dukat
+{
+	constexpr std::size_t EventQueue::max_payload;
+
+	EventQueue::EventQueue(int capacity) : entries(capacity), head(0), count(0), sequence(0), last_messenger_id(0), dropped(0), reported(0)
+	{
+		order.reserve(capacity);
+	}
+
+	// Offset of the second parameter in the payload.
+	static std::size_t param2_offset(std::size_t param1_size)
+	{
+		return (param1_size + 7) & ~static_cast<std::size_t>(7);
+	}
+
+	bool EventQueue::push(Messenger* target, const Message& message, std::size_t param1_size, std::size_t param2_size)
+	{
+		const auto payload_size = param2_offset(param1_size) + param2_size;
+		assert(payload_size <= max_payload);
+		if (count == get_capacity() || payload_size > max_payload)
+		{
+			dropped++;
+			return false;
+		}
+
+		auto& entry = entries[(head + count) % get_capacity()];
+		entry.target = target;
+		entry.target_id = target->get_queue_id();
+		entry.message = message;
+		entry.sequence = sequence++;
+		entry.param1_size = static_cast<uint8_t>(param1_size);
+		entry.param2_size = static_cast<uint8_t>(param2_size);
+		if (param1_size > 0)
+		{
+			std::memcpy(entry.payload, message.param1, param1_size);
+		}
+		if (param2_size > 0)
+		{
+			std::memcpy(entry.payload + param2_offset(param1_size), message.param2, param2_size);
+		}
+		count++;
+		return true;
+	}
+
+	void EventQueue::flush(void)
+	{
+		ProfileZone zone("EventQueue::flush");
+		if (dropped > reported)
+		{
+			log->warn("Event queue full, dropped {} messages.", dropped - reported);
+			reported = dropped;
+		}
+		if (count == 0)
+			return;
+
+		// Only deliver what is queued now, handlers may queue more
+		const auto n = count;
+		const auto capacity = get_capacity();
+		order.clear();
+		for (auto i = 0; i < n; i++)
+		{
+			order.push_back((head + i) % capacity);
+		}
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			const auto& ea = entries[a];
+			const auto& eb = entries[b];
+			if (ea.message.event != eb.message.event)
+				return ea.message.event < eb.message.event;
+			if (ea.target_id != eb.target_id)
+				return ea.target_id < eb.target_id;
+			// sequence numbers may wrap, compare distance instead
+			return static_cast<int32_t>(ea.sequence - eb.sequence) < 0;
+		});
+
+		for (auto index : order)
+		{
+			auto& entry = entries[index];
+			auto target = entry.target;
+			if (target == nullptr)
+				continue; // cancelled or already delivered
+			entry.target = nullptr;
+			if (entry.param1_size > 0)
+			{
+				entry.message.param1 = entry.payload;
+			}
+			if (entry.param2_size > 0)
+			{
+				entry.message.param2 = entry.payload + param2_offset(entry.param1_size);
+			}
+			target->dispatch(entry.message);
+		}
+
+		head = (head + n) % capacity;
+		count -= n;
+	}
+
+	void EventQueue::cancel(Messenger* target)
+	{
+		const auto capacity = get_capacity();
+		for (auto i = 0; i < count; i++)
+		{
+			auto& entry = entries[(head + i) % capacity];
+			if (entry.target == target)
+				entry.target = nullptr;
+		}
+	}
+
+	void EventQueue::dispatch_param(const void* param1)
+	{
+		const auto capacity = get_capacity();
+		// handlers may queue more messages, which are checked as well
+		for (auto i = 0; i < count; i++)
+		{
+			auto& entry = entries[(head + i) % capacity];
+			if (entry.target == nullptr || entry.param1_size > 0 || entry.message.param1 != param1)
+				continue;
+			auto target = entry.target;
+			auto message = entry.message;
+			if (entry.param2_size > 0)
+			{
+				message.param2 = entry.payload + param2_offset(entry.param1_size);
+			}
+			entry.target = nullptr;
+			target->dispatch(message);
+		}
+	}
+}
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include <dukat/game2.h>
+#include <dukat/particlemanager.h>
 #include <dukat/settings.h>
 
 namespace dukat
@@ -7,6 +8,8 @@ namespace dukat
 	Game2::Game2(Settings& settings) : GameBase(settings)
 	{
 		renderer = std::make_unique<Renderer2>(window.get(), shader_cache.get());
+		renderer->set_worker_pool(worker_pool.get());
+		renderer->set_particle_manager(get<ParticleManager>());
 	}
 
 	Game2::~Game2(void) 
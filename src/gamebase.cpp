@@ -7,6 +7,7 @@
 #include <dukat/manager.h>
 #include <dukat/meshcache.h>
 #include <dukat/particlemanager.h>
+#include <dukat/profiler.h>
 #include <dukat/scene.h>
 #include <dukat/settings.h>
 #include <dukat/shadercache.h>
@@ -15,6 +16,7 @@
 #include <dukat/texturecache.h>
 #include <dukat/timermanager.h>
 #include <dukat/window.h>
+#include <dukat/workerpool.h>
 
 namespace dukat
 {
@@ -26,6 +28,8 @@ namespace dukat
 		shader_cache = std::make_unique<ShaderCache>(settings.get_string("resources.shaders"));
 		texture_cache = std::make_unique<TextureCache>(settings.get_string("resources.textures"));
 		mesh_cache = std::make_unique<MeshCache>();
+		worker_pool = std::make_unique<WorkerPool>(settings.get_int("engine.workers", -1));
+		event_queue = std::make_unique<EventQueue>(settings.get_int("engine.event_queue", 4096));
 		add_manager<ParticleManager>();
 		add_manager<TimerManager>();
 		add_manager<AnimationManager>();
@@ -58,6 +62,7 @@ namespace dukat
 
 	void GameBase::update(float delta)
 	{
+		ProfileZone zone("GameBase::update");
 		// Scene first so that managers can operate on updated properties.
 		scene_stack.top()->update(delta);
 		for (auto& it : managers)
@@ -65,6 +70,8 @@ namespace dukat
 			if (it.second->is_enabled())
 				(it.second)->update(delta);
 		}
+		// Deliver deferred events once all state for this frame is final.
+		event_queue->flush();
 	}
 
 	void GameBase::render(void)
@@ -1,26 +1,68 @@
 #include "stdafx.h"
 #include <dukat/messenger.h>
+#include <dukat/eventqueue.h>
 
 namespace dukat
 {
-	void Messenger::trigger(const Message& message)
+	Messenger::~Messenger(void)
 	{
-		if (subscriptions.count(message.event))
+		if (queue != nullptr)
 		{
-			for (auto r : subscriptions[message.event])
+			queue->cancel(this);
+		}
+	}
+
+	void Messenger::trigger(const Message& message, std::size_t param1_size, std::size_t param2_size)
+	{
+		if (queue != nullptr)
+		{
+			queue->push(this, message, param1_size, param2_size);
+		}
+		else
+		{
+			dispatch(message);
+		}
+	}
+
+	void Messenger::dispatch(const Message& message)
+	{
+		if (message.event >= Events::Any)
+			return;
+
+		const auto& recipients = subscriptions[message.event];
+		// recipients added during dispatch will only receive later events
+		const auto count = recipients.size();
+		if (count == 0)
+			return;
+
+		dispatch_depth++;
+		for (auto i = 0u; i < count; i++)
+		{
+			auto r = recipients[i];
+			if (r != nullptr)
 			{
 				r->receive(message);
 			}
 		}
+		dispatch_depth--;
+
+		if (dispatch_depth == 0 && needs_compaction)
+		{
+			compact();
+		}
 	}
 
 	void Messenger::subscribe(Event ev, Recipient* recipient)
 	{
-		if (subscriptions.count(ev) == 0)
+		assert(ev < Events::Any);
+		if (ev >= Events::Any)
+			return;
+
+		auto& recipients = subscriptions[ev];
+		if (std::find(recipients.begin(), recipients.end(), recipient) == recipients.end())
 		{
-			subscriptions[ev] = std::set<Recipient*>();
+			recipients.push_back(recipient);
 		}
-		subscriptions[ev].insert(recipient);
 	}
 
 	void Messenger::subscribe_all(Recipient* recipient)
@@ -33,17 +75,53 @@ namespace dukat
 
 	void Messenger::unsubscribe(Event ev, Recipient* recipient)
 	{
-		if (subscriptions.count(ev))
+		if (ev >= Events::Any)
+			return;
+
+		auto& recipients = subscriptions[ev];
+		auto it = std::find(recipients.begin(), recipients.end(), recipient);
+		if (it == recipients.end())
+			return;
+
+		if (dispatch_depth > 0)
 		{
-			subscriptions[ev].erase(recipient);
+			// keep indices stable for dispatch in progress
+			*it = nullptr;
+			needs_compaction = true;
+		}
+		else
+		{
+			recipients.erase(it);
 		}
 	}
 
 	void Messenger::unsubscribe_all(Recipient* recipient)
 	{
-		for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it)
+		for (auto it = Events::None; it != Events::Any; ++it)
+		{
+			unsubscribe(it, recipient);
+		}
+	}
+
+	void Messenger::set_event_queue(EventQueue* queue)
+	{
+		if (this->queue != nullptr && this->queue != queue)
+		{
+			this->queue->cancel(this);
+		}
+		if (queue != nullptr && queue != this->queue)
+		{
+			queue_id = queue->register_messenger();
+		}
+		this->queue = queue;
+	}
+
+	void Messenger::compact(void)
+	{
+		for (auto& recipients : subscriptions)
 		{
-			it->second.erase(recipient);
+			recipients.erase(std::remove(recipients.begin(), recipients.end(), nullptr), recipients.end());
 		}
+		needs_compaction = false;
 	}
 }
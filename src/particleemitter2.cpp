@@ -0,0 +1,171 @@
+#include "stdafx.h"
+#include <dukat/particleemitter2.h>
+#include <dukat/game2.h>
+#include <dukat/particlemanager.h>
+#include <dukat/perfcounter.h>
+#include <dukat/renderer2.h>
+#include <dukat/renderlayer2.h>
+#include <dukat/shadercache.h>
+#include <dukat/shaderprogram.h>
+#include <dukat/sysutil.h>
+#include <cmath>
+
+namespace dukat
+{
+	// Particle state as captured by transform feedback.
+	struct EmitterVertex
+	{
+		GLfloat px, py, size, ry;
+		GLfloat cr, cg, cb, ca;
+		GLfloat dpx, dpy, dsize, ttl;
+		GLfloat dcr, dcg, dcb, dca;
+	};
+
+	ParticleEmitter2::ParticleEmitter2(Game2* game, int capacity) : game(game), capacity(capacity), update_program(nullptr),
+		current(0), active(0), next_slot(0), pending_time(0.0f), pending_spawn(0.0f), pending_burst(0), seed(0)
+	{
+#if OPENGL_VERSION >= 30
+		update_program = game->get_shaders()->get_feedback_program("fx_particle_update.vsh", "fx_particle_update.fsh",
+			{ "v_position", "v_color", "v_motion", "v_dcolor" });
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(2, buffers);
+		for (auto buffer : buffers)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(EmitterVertex), nullptr, GL_DYNAMIC_COPY);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		game->get<ParticleManager>()->add_emitter(this);
+#else
+		throw std::runtime_error("Particle emitters require OpenGL 3.0 or higher.");
+#endif
+	}
+
+	ParticleEmitter2::~ParticleEmitter2(void)
+	{
+#if OPENGL_VERSION >= 30
+		game->get<ParticleManager>()->remove_emitter(this);
+		glDeleteBuffers(2, buffers);
+		glDeleteVertexArrays(1, &vao);
+#endif
+	}
+
+	void ParticleEmitter2::update(float delta)
+	{
+		pending_time += delta;
+	}
+
+	void ParticleEmitter2::clear(void)
+	{
+		// slots are overwritten before they are read again
+		active = 0;
+		next_slot = 0;
+		pending_spawn = 0.0f;
+		pending_burst = 0;
+	}
+
+	// Points attribute name at one vec4 of the particle state in the current buffer.
+	static GLint bind_attribute(ShaderProgram* program, const char* name, std::size_t offset)
+	{
+		auto id = program->attr(name);
+		if (id != -1)
+		{
+			glEnableVertexAttribArray(id);
+			glVertexAttribPointer(id, 4, GL_FLOAT, GL_FALSE, sizeof(EmitterVertex), reinterpret_cast<const GLvoid*>(offset));
+		}
+		return id;
+	}
+
+	static void unbind_attribute(GLint id)
+	{
+		if (id != -1)
+			glDisableVertexAttribArray(id);
+	}
+
+	void ParticleEmitter2::simulate(Renderer2* renderer)
+	{
+#if OPENGL_VERSION >= 30
+		// Spawn window for this frame, in ring order
+		pending_spawn += params.rate * pending_time;
+		const auto spawn = std::floor(pending_spawn);
+		pending_spawn -= spawn;
+		const auto spawn_count = std::min(capacity, static_cast<int>(spawn) + pending_burst);
+		pending_burst = 0;
+		const auto spawn_start = next_slot;
+		next_slot = (next_slot + spawn_count) % capacity;
+		active = std::min(capacity, active + spawn_count);
+
+		const auto delta = pending_time;
+		pending_time = 0.0f;
+		if (active == 0)
+			return;
+
+		renderer->switch_shader(update_program);
+		update_program->set(update_program->attr("u_delta"), delta);
+		glUniform1i(update_program->attr("u_capacity"), capacity);
+		glUniform1i(update_program->attr("u_spawn_start"), spawn_start);
+		glUniform1i(update_program->attr("u_spawn_count"), spawn_count);
+		glUniform1i(update_program->attr("u_seed"), static_cast<GLint>(seed++));
+		update_program->set(update_program->attr("u_origin"), params.pos.x, params.pos.y, params.spread.x, params.spread.y);
+		update_program->set(update_program->attr("u_velocity"), params.min_dp.x, params.min_dp.y, params.max_dp.x, params.max_dp.y);
+		update_program->set(update_program->attr("u_size"), params.min_size, params.max_size, params.dsize, params.ry);
+		update_program->set(update_program->attr("u_ttl"), params.min_ttl, params.max_ttl);
+		update_program->set(update_program->attr("u_color"), params.color.r, params.color.g, params.color.b, params.color.a);
+		update_program->set(update_program->attr("u_dcolor"), params.dc.r, params.dc.g, params.dc.b, params.dc.a);
+
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+		auto pos_id = bind_attribute(update_program, Renderer::at_pos, offsetof(EmitterVertex, px));
+		auto color_id = bind_attribute(update_program, Renderer::at_color, offsetof(EmitterVertex, cr));
+		auto motion_id = bind_attribute(update_program, "a_motion", offsetof(EmitterVertex, dpx));
+		auto dcolor_id = bind_attribute(update_program, "a_dcolor", offsetof(EmitterVertex, dcr));
+
+		// Write advanced state into the other buffer without rasterizing anything
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, active);
+		glEndTransformFeedback();
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+		unbind_attribute(pos_id);
+		unbind_attribute(color_id);
+		unbind_attribute(motion_id);
+		unbind_attribute(dcolor_id);
+		current = 1 - current;
+#endif
+	}
+
+	void ParticleEmitter2::render(Renderer2* renderer, const AABB2& camera_bb)
+	{
+#if OPENGL_VERSION >= 30
+		simulate(renderer);
+		if (active == 0)
+			return;
+		perfc.inc(PerformanceCounter::PARTICLES, active);
+
+		auto layer = get_layer();
+		auto program = layer->get_particle_program();
+		renderer->switch_shader(program);
+		glUniform1f(program->attr("u_parallax"), layer->parallax);
+
+		// Expired particles are drawn as well, but are fully transparent
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+		auto pos_id = bind_attribute(program, Renderer::at_pos, offsetof(EmitterVertex, px));
+		auto color_id = bind_attribute(program, Renderer::at_color, offsetof(EmitterVertex, cr));
+		glDrawArrays(GL_POINTS, 0, active);
+		unbind_attribute(pos_id);
+		unbind_attribute(color_id);
+
+	#ifdef _DEBUG
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_check_error();
+	#endif
+#endif
+	}
+}
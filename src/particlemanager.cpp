@@ -1,45 +1,49 @@
 #include "stdafx.h"
 #include <dukat/particlemanager.h>
+#include <dukat/particleemitter2.h>
+#include <dukat/profiler.h>
+#include <dukat/gamebase.h>
 
 namespace dukat
 {
-	Particle* ParticleManager::create_particle(void)
+	ParticleStore* ParticleManager::create_store(int budget)
 	{
-		auto particle = std::make_unique<Particle>();
-		auto res = particle.get();
-		if (particles.size() == max_particles)
-		{
-			particles.pop_back();
-		}
-		particles.push_front(std::move(particle));
-		return res;
+		stores.push_back(std::make_unique<ParticleStore>(budget));
+		return stores.back().get();
+	}
+
+	void ParticleManager::destroy_store(ParticleStore* store)
+	{
+		stores.erase(std::remove_if(stores.begin(), stores.end(),
+			[store](const std::unique_ptr<ParticleStore>& ptr) { return ptr.get() == store; }), stores.end());
 	}
 
-	void ParticleManager::add_particle(std::unique_ptr<Particle> particle)
+	void ParticleManager::remove_emitter(ParticleEmitter2* emitter)
 	{
-		if (particles.size() == max_particles)
+		emitters.erase(std::remove(emitters.begin(), emitters.end(), emitter), emitters.end());
+	}
+
+	int ParticleManager::particle_count(void) const
+	{
+		auto res = 0;
+		for (const auto& store : stores)
 		{
-			particles.pop_back();
+			res += store->count();
 		}
-		particles.push_front(std::move(particle));
+		return res;
 	}
 
 	void ParticleManager::update(float delta)
 	{
-		for (auto it = particles.begin(); it != particles.end(); )
+		ProfileZone zone("ParticleManager::update");
+		auto pool = game->get_worker_pool();
+		for (auto& store : stores)
+		{
+			store->update(delta, pool);
+		}
+		for (auto emitter : emitters)
 		{
-			if ((*it)->ttl <= 0.0f)
-			{
-				it = particles.erase(it);
-			}
-			else
-			{
-				(*it)->ttl -= delta;
-				(*it)->pos += (*it)->dp * delta;
-				(*it)->color += (*it)->dc * delta;
-				(*it)->size += (*it)->dsize * delta;
-				++it;
-			}
+			emitter->update(delta);
 		}
 	}
 }
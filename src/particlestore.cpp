@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include <dukat/particlestore.h>
+#include <dukat/workerpool.h>
+
+namespace dukat
+{
+	constexpr int ParticleStore::chunk_size;
+
+	bool ParticleStore::add(const Particle& p)
+	{
+		if (count() >= capacity)
+			return false;
+		px.push_back(p.pos.x);
+		py.push_back(p.pos.y);
+		ry.push_back(p.ry);
+		size.push_back(p.size);
+		cr.push_back(p.color.r);
+		cg.push_back(p.color.g);
+		cb.push_back(p.color.b);
+		ca.push_back(p.color.a);
+		dpx.push_back(p.dp.x);
+		dpy.push_back(p.dp.y);
+		dcr.push_back(p.dc.r);
+		dcg.push_back(p.dc.g);
+		dcb.push_back(p.dc.b);
+		dca.push_back(p.dc.a);
+		dsize.push_back(p.dsize);
+		ttl.push_back(p.ttl);
+		return true;
+	}
+
+	ParticleStore::AttributeList ParticleStore::attributes(void)
+	{
+		return { &px, &py, &ry, &size, &cr, &cg, &cb, &ca,
+			&dpx, &dpy, &dcr, &dcg, &dcb, &dca, &dsize, &ttl };
+	}
+
+	void ParticleStore::clear(void)
+	{
+		for (auto attr : attributes())
+		{
+			attr->clear();
+		}
+	}
+
+	void ParticleStore::set_capacity(int capacity)
+	{
+		this->capacity = capacity;
+		if (count() <= capacity)
+			return;
+		for (auto attr : attributes())
+		{
+			attr->resize(capacity);
+		}
+	}
+
+	// Adds rate * delta to each value. Kept as a plain loop over two arrays so it vectorizes.
+	static void integrate(float* values, const float* rates, int n, float delta)
+	{
+		for (auto i = 0; i < n; i++)
+		{
+			values[i] += rates[i] * delta;
+		}
+	}
+
+	void ParticleStore::update_chunk(int chunk, float delta)
+	{
+		const auto begin = chunk * chunk_size;
+		const auto n = std::min(count() - begin, chunk_size);
+
+		auto t = ttl.data() + begin;
+		for (auto i = 0; i < n; i++)
+		{
+			t[i] -= delta;
+		}
+		integrate(px.data() + begin, dpx.data() + begin, n, delta);
+		integrate(py.data() + begin, dpy.data() + begin, n, delta);
+		integrate(cr.data() + begin, dcr.data() + begin, n, delta);
+		integrate(cg.data() + begin, dcg.data() + begin, n, delta);
+		integrate(cb.data() + begin, dcb.data() + begin, n, delta);
+		integrate(ca.data() + begin, dca.data() + begin, n, delta);
+		integrate(size.data() + begin, dsize.data() + begin, n, delta);
+
+		// Move the last live particle of the chunk into each expired slot
+		auto attrs = attributes();
+		auto live = n;
+		for (auto i = 0; i < live; i++)
+		{
+			if (t[i] > 0.0f)
+				continue;
+			while (live > i + 1 && t[live - 1] <= 0.0f)
+			{
+				live--;
+			}
+			live--;
+			if (live > i)
+			{
+				for (auto attr : attrs)
+				{
+					(*attr)[begin + i] = (*attr)[begin + live];
+				}
+			}
+		}
+		chunk_live[chunk] = live;
+	}
+
+	void ParticleStore::plan_moves(int live)
+	{
+		// Walk gaps below live from the front and particles above it from the back
+		moves.clear();
+		const auto chunks = static_cast<int>(chunk_live.size());
+		auto src_chunk = chunks;
+		auto src_begin = 0;
+		auto src_end = 0;
+		for (auto chunk = 0; chunk < chunks; chunk++)
+		{
+			auto gap = chunk * chunk_size + chunk_live[chunk];
+			const auto gap_end = std::min((chunk + 1) * chunk_size, live);
+			while (gap < gap_end)
+			{
+				if (src_begin >= src_end)
+				{
+					src_chunk--;
+					src_begin = std::max(src_chunk * chunk_size, live);
+					src_end = src_chunk * chunk_size + chunk_live[src_chunk];
+					continue;
+				}
+				const auto count = std::min(gap_end - gap, src_end - src_begin);
+				src_end -= count;
+				moves.push_back(Move{ gap, src_end, count });
+				gap += count;
+			}
+		}
+	}
+
+	void ParticleStore::apply_move(const Move& move)
+	{
+		for (auto attr : attributes())
+		{
+			auto v = attr->data();
+			std::copy(v + move.src, v + move.src + move.count, v + move.dst);
+		}
+	}
+
+	void ParticleStore::update(float delta, WorkerPool* pool)
+	{
+		if (empty())
+			return;
+
+		const auto n = count();
+		const auto chunks = (n + chunk_size - 1) / chunk_size;
+		chunk_live.resize(chunks);
+		if (pool != nullptr && chunks > 1)
+		{
+			pool->parallel_for(chunks, [&](int chunk) { update_chunk(chunk, delta); });
+		}
+		else
+		{
+			for (auto chunk = 0; chunk < chunks; chunk++)
+			{
+				update_chunk(chunk, delta);
+			}
+		}
+
+		auto live = 0;
+		for (auto chunk = 0; chunk < chunks; chunk++)
+		{
+			live += chunk_live[chunk];
+		}
+		if (live == n)
+			return;
+
+		// Gaps lie below live and particles to fill them above, so moves never overlap
+		plan_moves(live);
+		const auto move_count = static_cast<int>(moves.size());
+		if (pool != nullptr && move_count > 1)
+		{
+			pool->parallel_for(move_count, [&](int i) { apply_move(moves[i]); });
+		}
+		else
+		{
+			for (const auto& move : moves)
+			{
+				apply_move(move);
+			}
+		}
+		for (auto attr : attributes())
+		{
+			attr->resize(live);
+		}
+	}
+}
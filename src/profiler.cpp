@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include <dukat/profiler.h>
+#include <dukat/log.h>
+#include <chrono>
+#include <fstream>
+
+namespace dukat
+{
+	Profiler profiler;
+
+	constexpr uint32_t Profiler::buffer_size;
+
+	int64_t Profiler::now(void)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	Profiler::ThreadBuffer* Profiler::get_thread_buffer(void)
+	{
+		// Buffers are never released, so the pointer stays valid for the lifetime of the thread.
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(buffers.size()) + 1));
+			buffer = buffers.back().get();
+		}
+		return buffer;
+	}
+
+	void Profiler::start(void)
+	{
+		since.store(now(), std::memory_order_relaxed);
+		recording.store(true, std::memory_order_relaxed);
+	}
+
+	void Profiler::record(const char* name, int64_t start, int64_t end)
+	{
+		auto buffer = get_thread_buffer();
+		// only the owning thread writes, so a plain load is enough
+		const auto index = buffer->count.load(std::memory_order_relaxed);
+		auto& zone = buffer->zones[index & (buffer_size - 1)];
+		zone.name = name;
+		zone.start = start;
+		zone.duration = end - start;
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	// Writes a string as JSON string literal.
+	static void write_string(std::ostream& os, const char* str)
+	{
+		os << '"';
+		for (auto c = str; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+				os << '\\';
+			os << *c;
+		}
+		os << '"';
+	}
+
+	bool Profiler::save(const std::string& filename)
+	{
+		log->info("Saving profile to: {}", filename);
+		std::ofstream os(filename);
+		if (!os)
+		{
+			log->warn("Failed to open profile: {}", filename);
+			return false;
+		}
+
+		const auto origin = since.load(std::memory_order_relaxed);
+		auto first = true;
+		os << "{\"traceEvents\":[";
+		os.setf(std::ios::fixed);
+		os.precision(3);
+		std::lock_guard<std::mutex> lock(mtx);
+		for (const auto& buffer : buffers)
+		{
+			const auto count = buffer->count.load(std::memory_order_acquire);
+			const auto available = std::min(count, buffer_size);
+			for (auto i = count - available; i != count; i++)
+			{
+				const auto& zone = buffer->zones[i & (buffer_size - 1)];
+				if (zone.start < origin)
+					continue;
+				os << (first ? "\n" : ",\n") << "{\"name\":";
+				write_string(os, zone.name);
+				// Chrome expects timestamps in microseconds
+				os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+					<< ",\"ts\":" << static_cast<double>(zone.start - origin) / 1000.0
+					<< ",\"dur\":" << static_cast<double>(zone.duration) / 1000.0 << "}";
+				first = false;
+			}
+		}
+		os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return true;
+	}
+}
@@ -10,11 +10,15 @@
 #include <dukat/meshbuilder2.h>
 #include <dukat/meshdata.h>
 #include <dukat/textureutil.h>
+#include <dukat/perfcounter.h>
+#include <dukat/profiler.h>
+#include <dukat/workerpool.h>
+#include <chrono>
 
 namespace dukat
 {
 	Renderer2::Renderer2(Window* window, ShaderCache* shader_cache) : Renderer(window, shader_cache), 
-		render_effects(true), render_sprites(true), render_particles(true), render_text(true)
+		worker_pool(nullptr), particle_manager(nullptr), render_effects(true), render_sprites(true), render_particles(true), render_text(true)
 	{
 		// Enable transparency
 		set_blending(true);
@@ -49,15 +53,22 @@ namespace dukat
 			{ 0.5f,  0.5f, 1.0f, 1.0f }
 		};
 		// Create buffer for sprite rendering
+#ifdef SPRITE_INSTANCING
+		sprite_buffer = std::make_unique<VertexBuffer>(2);
+		sprite_buffer->load_data(0, GL_ARRAY_BUFFER, 4, sizeof(Vertex2PT), vertices, GL_STATIC_DRAW);
+		// Per-instance data is streamed in every frame
+		sprite_buffer->load_data(1, GL_ARRAY_BUFFER, max_sprite_batch, sizeof(Vertex2PSRTC), nullptr, GL_STREAM_DRAW);
+#else
 		sprite_buffer = std::make_unique<VertexBuffer>(1);
 		sprite_buffer->load_data(0, GL_ARRAY_BUFFER, 4, sizeof(Vertex2PT), vertices, GL_STATIC_DRAW);
+#endif
 	}
 
 	void Renderer2::initialize_particle_buffers(void)
 	{
-		// Create buffer for particle rendering
-		particle_buffer = std::make_unique<VertexBuffer>(1);
-		particle_buffer->load_data(0, GL_ARRAY_BUFFER, max_particles, sizeof(Vertex2PSC), nullptr, GL_STREAM_DRAW);
+		// Particle data is streamed, so the vertex buffer only provides the vertex array object
+		particle_buffer = std::make_unique<VertexBuffer>(0);
+		particle_stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, max_particles * sizeof(Vertex2PSRC));
 	}
 
 	void Renderer2::initialize_frame_buffer(void)
@@ -82,7 +93,7 @@ namespace dukat
 	RenderLayer2* Renderer2::create_layer(const std::string& id, float priority, float parallax)
 	{
 		auto layer = std::make_unique<RenderLayer2>(shader_cache, 
-			sprite_buffer.get(), particle_buffer.get(), id, priority, parallax);
+			sprite_buffer.get(), particle_buffer.get(), particle_stream.get(), particle_manager, id, priority, parallax);
 		auto res = layer.get();
 		bool inserted = false;
 		// find position to insert based on priority
@@ -169,7 +180,9 @@ namespace dukat
 
 	void Renderer2::render(void)
 	{
+		ProfileZone zone("Renderer2::render");
 		window->clear();
+		particle_stream->begin_frame();
 
 #if OPENGL_VERSION >= 30
 		// This will pick up the change we made to camera transform. Since we're 
@@ -177,6 +190,11 @@ namespace dukat
 		update_uniforms();
 #endif
 
+		if (render_sprites)
+		{
+			prepare_sprites();
+		}
+
 		// Scene pass
 		for (auto& layer : layers)
 		{
@@ -221,6 +239,7 @@ namespace dukat
 			}
 		}
 
+		particle_stream->end_frame();
 		window->present();
 
 #if OPENGL_VERSION < 30
@@ -230,6 +249,38 @@ namespace dukat
 #endif
 	}
 
+	void Renderer2::prepare_sprites(void)
+	{
+		prepared_layers.clear();
+		for (auto& layer : layers)
+		{
+			if (layer->visible() && layer->has_sprites())
+			{
+				prepared_layers.push_back(layer.get());
+			}
+		}
+		if (prepared_layers.empty())
+			return;
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		if (worker_pool != nullptr && prepared_layers.size() > 1)
+		{
+			worker_pool->parallel_for(static_cast<int>(prepared_layers.size()), [&](int i) {
+				prepared_layers[i]->prepare_sprites(camera.get());
+			});
+		}
+		else
+		{
+			for (auto layer : prepared_layers)
+			{
+				layer->prepare_sprites(camera.get());
+			}
+		}
+		const auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		perfc.inc(PerformanceCounter::SPRITE_PREPARE,
+			static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+	}
+
 	void Renderer2::update_uniforms(void)
 	{
 #if OPENGL_VERSION >= 30
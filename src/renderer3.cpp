@@ -6,6 +6,7 @@
 #include <dukat/meshbuilder2.h>
 #include <dukat/meshgroup.h>
 #include <dukat/perfcounter.h>
+#include <dukat/profiler.h>
 #include <dukat/shadercache.h>
 #include <dukat/shaderprogram.h>
 #include <dukat/sysutil.h>
@@ -85,6 +86,7 @@ namespace dukat
 
 	void Renderer3::render(const std::vector<Mesh*>& meshes)
 	{
+		ProfileZone zone("Renderer3::render");
 #if OPENGL_VERSION >= 30
 		// Update uniform buffers once per frame.
 		update_uniforms();
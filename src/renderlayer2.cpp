@@ -4,25 +4,31 @@
 #include <dukat/buffers.h>
 #include <dukat/camera2.h>
 #include <dukat/effect2.h>
+#include <dukat/mathutil.h>
 #include <dukat/matrix4.h>
 #include <dukat/particle.h>
+#include <dukat/particlemanager.h>
+#include <dukat/log.h>
 #include <dukat/perfcounter.h>
+#include <dukat/radixsort.h>
 #include <dukat/shadercache.h>
 #include <dukat/sprite.h>
+#include <dukat/spritechunkcache.h>
+#include <dukat/spritegrid.h>
+#include <dukat/streambuffer.h>
 #include <dukat/textmeshinstance.h>
 #include <dukat/renderer2.h>
 #include <dukat/vertextypes2.h>
+#include <chrono>
 
 namespace dukat
 {
 	typedef Vertex2PSRC PVertex;
 
-	// module-global buffer for particle data used during rendering
-	static PVertex particle_data[Renderer2::max_particles];
-
-	RenderLayer2::RenderLayer2(ShaderCache* shader_cache, VertexBuffer* sprite_buffer, VertexBuffer* particle_buffer,
-	    const std::string& id, float priority, float parallax) : composite_binder(nullptr),
-		 sprite_buffer(sprite_buffer), particle_buffer(particle_buffer), is_visible(true),
+	RenderLayer2::RenderLayer2(ShaderCache* shader_cache, VertexBuffer* sprite_buffer, VertexBuffer* particle_buffer, StreamBuffer* particle_stream,
+		ParticleManager* particle_manager, const std::string& id, float priority, float parallax) : composite_binder(nullptr),
+		shader_cache(shader_cache), sprite_buffer(sprite_buffer), particle_buffer(particle_buffer), particle_stream(particle_stream), sprites_prepared(false),
+		sort_time(0), particle_manager(particle_manager), particles(nullptr), particle_budget(ParticleManager::default_budget), is_visible(true),
 		id(id), parallax(parallax), priority(priority), stage(RenderStage::SCENE)
 	{
 		sprite_program = shader_cache->get_program("sc_sprite.vsh", "sc_sprite.fsh");
@@ -32,16 +38,108 @@ namespace dukat
 
 	RenderLayer2::~RenderLayer2(void)
 	{
+		if (particles != nullptr)
+		{
+			particle_manager->destroy_store(particles);
+		}
 	}
 
 	void RenderLayer2::add(Sprite* sprite)
 	{
 		sprites.push_back(sprite);
+		index(sprite);
 	}
 
 	void RenderLayer2::remove(Sprite* sprite)
 	{
 		sprites.erase(std::remove(sprites.begin(), sprites.end(), sprite), sprites.end());
+		// do not keep a reference for resetting the rendered flag
+		visible_sprites.erase(std::remove_if(visible_sprites.begin(), visible_sprites.end(), 
+			[sprite](const SpriteEntry& e) { return e.sprite == sprite; }), visible_sprites.end());
+		// packed sprite data no longer lines up with visible sprites, prepare again
+		sprites_prepared = false;
+		unindex(sprite);
+	}
+
+	void RenderLayer2::update(Sprite* sprite)
+	{
+		if (!is_indexed())
+			return;
+		const auto was_relative = std::find(relative_sprites.begin(), relative_sprites.end(), sprite) != relative_sprites.end();
+		if (was_relative != sprite->relative)
+		{
+			unindex(sprite);
+			index(sprite);
+		}
+		else if (sprite->relative)
+		{
+			return;
+		}
+		else if (static_sprites != nullptr)
+		{
+			static_sprites->update(sprite);
+		}
+		else
+		{
+			sprite_grid->update(sprite);
+		}
+	}
+
+	void RenderLayer2::index(Sprite* sprite)
+	{
+		if (!is_indexed())
+			return;
+		if (sprite->relative)
+			relative_sprites.push_back(sprite);
+		else if (static_sprites != nullptr)
+			static_sprites->add(sprite);
+		else
+			sprite_grid->insert(sprite);
+	}
+
+	void RenderLayer2::unindex(Sprite* sprite)
+	{
+		relative_sprites.erase(std::remove(relative_sprites.begin(), relative_sprites.end(), sprite), relative_sprites.end());
+		if (static_sprites != nullptr)
+			static_sprites->remove(sprite);
+		if (sprite_grid != nullptr)
+			sprite_grid->remove(sprite);
+	}
+
+	void RenderLayer2::rebuild_index(void)
+	{
+		relative_sprites.clear();
+		if (static_sprites != nullptr)
+			static_sprites->clear();
+		if (sprite_grid != nullptr)
+			sprite_grid->clear();
+		for (auto sprite : sprites)
+		{
+			index(sprite);
+		}
+	}
+
+	void RenderLayer2::set_sprite_grid(float cell_size)
+	{
+		if (cell_size <= 0.0f)
+			sprite_grid = nullptr;
+		else
+			sprite_grid = std::make_unique<SpriteGrid>(cell_size);
+		rebuild_index();
+	}
+
+	void RenderLayer2::set_static(bool static_layer, float chunk_size)
+	{
+		if (static_layer)
+		{
+			auto program = shader_cache->get_program("sc_sprite_static.vsh", "sc_sprite_static.fsh");
+			static_sprites = std::make_unique<SpriteChunkCache>(program, chunk_size);
+		}
+		else
+		{
+			static_sprites = nullptr;
+		}
+		rebuild_index();
 	}
 
 	Effect2* RenderLayer2::add(std::unique_ptr<Effect2> fx)
@@ -63,14 +161,32 @@ namespace dukat
 		}
 	}
 
-	void RenderLayer2::add(Particle* particle)
+	bool RenderLayer2::add(const Particle& p)
 	{
-		particles.push_front(particle);
+		if (particles == nullptr)
+		{
+			if (particle_manager == nullptr)
+			{
+				log->warn("Layer {} cannot hold particles without a particle manager.", id);
+				return false;
+			}
+			particles = particle_manager->create_store(particle_budget);
+		}
+		return particles->add(p);
 	}
 
-	void RenderLayer2::remove(Particle* p)
+	bool RenderLayer2::has_particles(void) const
 	{
-		particles.erase(std::remove(particles.begin(), particles.end(), p), particles.end());
+		return particles != nullptr && !particles->empty();
+	}
+
+	void RenderLayer2::set_particle_budget(int budget)
+	{
+		particle_budget = budget;
+		if (particles != nullptr)
+		{
+			particles->set_capacity(budget);
+		}
 	}
 
 	void RenderLayer2::add(TextMeshInstance * text)
@@ -83,13 +199,17 @@ namespace dukat
 		texts.erase(std::remove(texts.begin(), texts.end(), text), texts.end());
 	}
 
-	void RenderLayer2::render(Renderer2* renderer)
+	AABB2 RenderLayer2::camera_bounds(const Camera2* camera) const
 	{
 		// Compute bounding box for current layer adjusted for parallax value
-		auto camera = renderer->get_camera();
 		Vector2 camera_pos = camera->transform.position * parallax;
 		Vector2 camera_dim = camera->transform.dimension / 2.0f;
-		AABB2 camera_bb(camera_pos - camera_dim, camera_pos + camera_dim);
+		return AABB2(camera_pos - camera_dim, camera_pos + camera_dim);
+	}
+
+	void RenderLayer2::render(Renderer2* renderer)
+	{
+		const auto camera_bb = camera_bounds(renderer->get_camera());
 
 		if (has_effects() && renderer->is_render_effects())
 		{
@@ -107,81 +227,181 @@ namespace dukat
 		{
 			render_text(renderer, camera_bb);
 		}
+		// prepared sprites are only valid for a single frame
+		sprites_prepared = false;
 	}
 
 	void RenderLayer2::clear(void)
 	{
 		sprites.clear();
+		relative_sprites.clear();
+		visible_sprites.clear();
+		sprites_prepared = false;
+		if (static_sprites != nullptr)
+			static_sprites->clear();
+		if (sprite_grid != nullptr)
+			sprite_grid->clear();
 		effects.clear();
-		particles.clear();
+		if (particles != nullptr)
+			particles->clear();
 		texts.clear();
 	}
 
-	void RenderLayer2::fill_sprite_queue(const AABB2& camera_bb,
-		std::priority_queue<Sprite*, std::deque<Sprite*>, SpriteComparator>& queue)
+	void RenderLayer2::collect_sprites(const AABB2& camera_bb)
 	{
-		// Fill queue with sprites ordered by priority from low to high
-		for (auto sprite : sprites)
+		auto add_visible = [&](Sprite* sprite) {
+			sprite->rendered = true;
+			visible_sprites.push_back(SpriteEntry{ sprite->sort_key(), sprite });
+		};
+
+		if (is_indexed())
 		{
-			if (sprite->relative)
+			// Only sprites found by the grid are touched, so reset the ones rendered last frame
+			for (const auto& entry : visible_sprites)
 			{
-				// TODO: perform occlusion check against untranslated camera bounding box
-				sprite->rendered = true;
-				queue.push(sprite);
-				perfc.inc(PerformanceCounter::SPRITES);
+				entry.sprite->rendered = false;
 			}
-			else
+			visible_sprites.clear();
+			for (auto sprite : relative_sprites)
 			{
-				Vector2 half_dim(sprite->scale * sprite->w / 2.0f, sprite->scale * sprite->h / 2.0f);
-				auto min_p = sprite->p - half_dim;
-				auto max_p = sprite->p + half_dim;
-
-				if (sprite->center > 0)
-				{
-					if ((sprite->center & Sprite::align_bottom) == Sprite::align_bottom)
-					{
-						min_p.y -= (sprite->h / 2) * sprite->scale;
-						max_p.y -= (sprite->h / 2) * sprite->scale;
-					}
-					else if ((sprite->center & Sprite::align_top) == Sprite::align_top)
-					{
-						min_p.y += (sprite->h / 2) * sprite->scale;
-						max_p.y += (sprite->h / 2) * sprite->scale;
-					}
-					if ((sprite->center & Sprite::align_right) == Sprite::align_right)
-					{
-						min_p.x -= (sprite->w / 2) * sprite->scale;
-						max_p.x -= (sprite->w / 2) * sprite->scale;
-					}
-					else if ((sprite->center & Sprite::align_left) == Sprite::align_left)
-					{
-						min_p.x += (sprite->w / 2) * sprite->scale;
-						max_p.x += (sprite->w / 2) * sprite->scale;
-					}
-				}
-
-				AABB2 sprite_bb(min_p, max_p);
-				if (!camera_bb.overlaps(sprite_bb))
+				add_visible(sprite);
+			}
+			// static sprites are culled by chunk when rendered
+			if (static_sprites == nullptr)
+			{
+				sprite_grid->query(camera_bb, [&](Sprite* sprite) {
+					if (camera_bb.overlaps(sprite->bounds()))
+						add_visible(sprite);
+				});
+			}
+		}
+		else
+		{
+			visible_sprites.clear();
+			for (auto sprite : sprites)
+			{
+				// TODO: perform occlusion check of relative sprites against untranslated camera bounding box
+				if (sprite->relative || camera_bb.overlaps(sprite->bounds()))
 				{
-					sprite->rendered = false;
+					add_visible(sprite);
 				}
 				else
 				{
-					sprite->rendered = true;
-					queue.push(sprite);
-					perfc.inc(PerformanceCounter::SPRITES);
+					sprite->rendered = false;
 				}
 			}
 		}
+
+		// Order sprites by priority from low to high
+		const auto start = std::chrono::high_resolution_clock::now();
+		radix_sort(visible_sprites, sort_buffer);
+		const auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		sort_time = static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+	}
+
+	void RenderLayer2::prepare_sprites(const Camera2* camera)
+	{
+		// may run on a worker thread, so performance counters are updated when rendering
+		collect_sprites(camera_bounds(camera));
+
+		const auto& camera_position = camera->transform.position;
+#ifdef SPRITE_INSTANCING
+		sprite_instances.resize(visible_sprites.size());
+		auto inst = sprite_instances.data();
+		for (const auto& entry : visible_sprites)
+		{
+			auto sprite = entry.sprite;
+			const auto pos = compute_position(*sprite, camera_position);
+			inst->px = pos.x;
+			inst->py = pos.y;
+			inst->sx = sprite->scale * sprite->w;
+			inst->sy = sprite->scale * sprite->h;
+			if (sprite->rot != 0.0f)
+			{
+				sin_cos(inst->rs, inst->rc, sprite->rot);
+			}
+			else
+			{
+				inst->rc = 1.0f;
+				inst->rs = 0.0f;
+			}
+			inst->tu = sprite->tex[0];
+			inst->tv = sprite->tex[1];
+			inst->tw = sprite->tex[2];
+			inst->th = sprite->tex[3];
+			inst->cr = sprite->color.r;
+			inst->cg = sprite->color.g;
+			inst->cb = sprite->color.b;
+			inst->ca = sprite->color.a;
+			++inst;
+		}
+#else
+		sprite_models.resize(visible_sprites.size());
+		for (auto i = 0u; i < visible_sprites.size(); i++)
+		{
+			compute_model_matrix(*visible_sprites[i].sprite, camera_position, sprite_models[i]);
+		}
+#endif
+		sprites_prepared = true;
 	}
 
 	void RenderLayer2::render_sprites(Renderer2* renderer, const AABB2& camera_bb)
 	{
-		static std::priority_queue<Sprite*, std::deque<Sprite*>, SpriteComparator> queue;
-		fill_sprite_queue(camera_bb, queue);
-		if (queue.empty())
-			return; // nothing to render
+		const auto chunks_visible = static_sprites != nullptr && static_sprites->prepare(camera_bb);
 
+		// prepare here unless the renderer has already done so for this frame
+		const auto prepared_inline = !sprites_prepared;
+		if (prepared_inline)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			prepare_sprites(renderer->get_camera());
+			const auto elapsed = std::chrono::high_resolution_clock::now() - start;
+			perfc.inc(PerformanceCounter::SPRITE_PREPARE,
+				static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+		}
+		perfc.inc(PerformanceCounter::SPRITES, static_cast<int>(visible_sprites.size()));
+		perfc.inc(PerformanceCounter::SPRITE_SORT, sort_time);
+		if (prepared_inline)
+		{
+			// do not reuse results of an inline prepare in a later frame
+			sprites_prepared = false;
+		}
+
+		const auto submit_start = std::chrono::high_resolution_clock::now();
+
+		const auto total = static_cast<int>(visible_sprites.size());
+		if (chunks_visible)
+		{
+			// Interleave baked chunks with the relative sprites by z value. Where
+			// both share a z value, the chunks are drawn first.
+			uint64_t z_begin = 0;
+			for (auto first = 0; first < total; )
+			{
+				const auto z = visible_sprites[first].key >> 32;
+				auto last = first + 1;
+				while (last < total && (visible_sprites[last].key >> 32) == z)
+				{
+					last++;
+				}
+				static_sprites->render(renderer, parallax, z_begin, z + 1);
+				draw_sprites(renderer, first, last);
+				z_begin = z + 1;
+				first = last;
+			}
+			static_sprites->render(renderer, parallax, z_begin);
+		}
+		else if (total > 0)
+		{
+			draw_sprites(renderer, 0, total);
+		}
+
+		const auto submit_elapsed = std::chrono::high_resolution_clock::now() - submit_start;
+		perfc.inc(PerformanceCounter::SPRITE_SUBMIT,
+			static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(submit_elapsed).count()));
+	}
+
+	void RenderLayer2::draw_sprites(Renderer2* renderer, int begin, int end)
+	{
 		renderer->switch_shader(sprite_program);
 
 		// Set parallax value for this layer
@@ -217,20 +437,79 @@ namespace dukat
 
 		// set texture unit 0 
 		glUniform1i(sprite_program->attr(Renderer::uf_tex0), 0);
-		
+
+		GLuint last_texture = -1;
+
+#ifdef SPRITE_INSTANCING
+		// Per-instance attributes advance once per sprite
+		const GLint instance_ids[] = {
+			sprite_program->attr("a_transform"),
+			sprite_program->attr("a_rotation"),
+			sprite_program->attr("a_uvwh"),
+			sprite_program->attr(Renderer::at_color)
+		};
+		glBindBuffer(GL_ARRAY_BUFFER, sprite_buffer->buffers[1]);
+		for (auto id : instance_ids)
+		{
+			glEnableVertexAttribArray(id);
+			glVertexAttribDivisor(id, 1);
+		}
+
+		for (auto batch = begin; batch < end; batch += Renderer2::max_sprite_batch)
+		{
+			// Upload as many prepared sprites as fit into the instance buffer
+			const auto count = std::min(end - batch, Renderer2::max_sprite_batch);
+			const auto entries = visible_sprites.data() + batch;
+
+			// Orphan buffer to improve streaming performance
+			glBufferData(GL_ARRAY_BUFFER, Renderer2::max_sprite_batch * sizeof(Vertex2PSRTC), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Vertex2PSRTC), sprite_instances.data() + batch);
+
+			// Draw each run of sprites sharing a texture with a single call
+			for (auto first = 0; first < count; )
+			{
+				const auto texture_id = entries[first].sprite->texture_id;
+				auto last = first + 1;
+				while (last < count && entries[last].sprite->texture_id == texture_id)
+				{
+					last++;
+				}
+
+				// switch texture if necessary
+				if (last_texture != texture_id)
+				{
+					perfc.inc(PerformanceCounter::TEXTURES);
+					glActiveTexture(GL_TEXTURE0);
+					glBindTexture(GL_TEXTURE_2D, texture_id);
+					last_texture = texture_id;
+				}
+
+				// point instance attributes at the first sprite of this run
+				const auto offset = first * sizeof(Vertex2PSRTC);
+				glVertexAttribPointer(instance_ids[0], 4, GL_FLOAT, GL_FALSE, sizeof(Vertex2PSRTC),
+					reinterpret_cast<const GLvoid*>(offset + offsetof(Vertex2PSRTC, px)));
+				glVertexAttribPointer(instance_ids[1], 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2PSRTC),
+					reinterpret_cast<const GLvoid*>(offset + offsetof(Vertex2PSRTC, rc)));
+				glVertexAttribPointer(instance_ids[2], 4, GL_FLOAT, GL_FALSE, sizeof(Vertex2PSRTC),
+					reinterpret_cast<const GLvoid*>(offset + offsetof(Vertex2PSRTC, tu)));
+				glVertexAttribPointer(instance_ids[3], 4, GL_FLOAT, GL_FALSE, sizeof(Vertex2PSRTC),
+					reinterpret_cast<const GLvoid*>(offset + offsetof(Vertex2PSRTC, cr)));
+
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, last - first);
+				perfc.inc(PerformanceCounter::DRAW_CALLS);
+				first = last;
+			}
+		}
+#else
 		// Get uniforms that will be set for each sprite
 		auto uvwh_id = sprite_program->attr("u_uvwh");
 		auto color_id = sprite_program->attr(Renderer::uf_color);
 		auto model_id = sprite_program->attr(Renderer::uf_model);
 
 		// Render in order
-		GLuint last_texture = -1;
-		Matrix4 mat_m;
-		while (!queue.empty())
+		for (auto i = begin; i < end; i++)
 		{
-			// get top element from queue
-			auto sprite = queue.top();
-			queue.pop();
+			auto sprite = visible_sprites[i].sprite;
 
 			// switch texture if necessary
 			if (last_texture != sprite->texture_id)
@@ -243,19 +522,26 @@ namespace dukat
 				last_texture = sprite->texture_id;
 			}
 
-			compute_model_matrix(*sprite, renderer->get_camera()->transform.position, mat_m);
-			glUniformMatrix4fv(model_id, 1, false, &mat_m.m[0]);
+			glUniformMatrix4fv(model_id, 1, false, &sprite_models[i].m[0]);
 			glUniform4fv(color_id, 1, &sprite->color.r);
 			glUniform4fv(uvwh_id, 1, sprite->tex);
 			
 			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			perfc.inc(PerformanceCounter::DRAW_CALLS);
 		}
+#endif
 
 #ifdef _DEBUG
 	#if OPENGL_VERSION >= 30
 		// unbind buffers
 		glDisableVertexAttribArray(pos_id);
 		glDisableVertexAttribArray(uv_id);
+	#ifdef SPRITE_INSTANCING
+		for (auto id : instance_ids)
+		{
+			glDisableVertexAttribArray(id);
+		}
+	#endif
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindVertexArray(0);
 	#else
@@ -266,7 +552,7 @@ namespace dukat
 #endif
 	}
 
-	void RenderLayer2::compute_model_matrix(const Sprite& sprite, const Vector2& camera_position, Matrix4& mat_model)
+	Vector2 RenderLayer2::compute_position(const Sprite& sprite, const Vector2& camera_position) const
 	{
 		Vector2 pos = sprite.p;
 
@@ -303,9 +589,15 @@ namespace dukat
 			pos.x = std::round(pos.x);
 			pos.y = std::round(pos.y);
 		}
+		return pos;
+	}
+
+	void RenderLayer2::compute_model_matrix(const Sprite& sprite, const Vector2& camera_position, Matrix4& mat_model) const
+	{
+		const auto pos = compute_position(sprite, camera_position);
 
 		// scale * rotation * translation
-		static Matrix4 tmp;
+		Matrix4 tmp;
 		mat_model.setup_translation(Vector3(pos.x, pos.y, 0.0f));
 		if (sprite.rot != 0.0f)
 		{
@@ -322,33 +614,24 @@ namespace dukat
 		// which fall just outside of screen rect; otherwise these will cause flickering
 		const Vector2 padding{ 4, 4 };
 		const auto bb = AABB2{ camera_bb.min - padding, camera_bb.max + padding };
+
+		// Write visible particles straight into the stream buffer
+		const auto& ps = *particles;
+		GLsizeiptr size = ps.count() * sizeof(PVertex);
+		GLintptr offset = 0;
+		auto data = static_cast<PVertex*>(particle_stream->map(size, offset));
+		const auto capacity = data == nullptr ? 0 : static_cast<int>(size / sizeof(PVertex));
 		auto particle_count = 0;
-		for (auto it = particles.begin(); it != particles.end(); )
+		for (auto i = 0; i < ps.count() && particle_count < capacity; i++)
 		{
-			Particle* p = (*it);
-			// remove dead particles
-			if (p->ttl <= 0)
-			{
-				it = particles.erase(it);
+			if (ps.px[i] < bb.min.x || ps.px[i] > bb.max.x || ps.py[i] < bb.min.y || ps.py[i] > bb.max.y)
 				continue;
-			}
-
-			// check if particle visible and store result in ->rendered
-			if ((p->rendered = bb.contains(p->pos)))
-			{
-				particle_data[particle_count].px = p->pos.x;
-				particle_data[particle_count].py = p->pos.y;
-				particle_data[particle_count].size = p->size;
-				particle_data[particle_count].ry = p->ry;
-				particle_data[particle_count].cr = p->color.r;
-				particle_data[particle_count].cg = p->color.g;
-				particle_data[particle_count].cb = p->color.b;
-				particle_data[particle_count].ca = p->color.a;
-				perfc.inc(PerformanceCounter::PARTICLES);
-				particle_count++;
-			}
-			++it;
+			// write whole vertices in order, mapped memory may be uncached
+			*data++ = PVertex{ ps.px[i], ps.py[i], ps.size[i], ps.ry[i], ps.cr[i], ps.cg[i], ps.cb[i], ps.ca[i] };
+			particle_count++;
 		}
+		particle_stream->unmap(particle_count * sizeof(PVertex));
+		perfc.inc(PerformanceCounter::PARTICLES, particle_count);
 
 		if (particle_count == 0)
 		{
@@ -363,35 +646,28 @@ namespace dukat
 #if OPENGL_VERSION >= 30
 		// bind particle vertex buffers
 		glBindVertexArray(particle_buffer->vao);
-		glBindBuffer(GL_ARRAY_BUFFER, particle_buffer->buffers[0]);
-		// Orphan buffer to improve streaming performance
-		glBufferData(GL_ARRAY_BUFFER, Renderer2::max_particles * sizeof(PVertex), nullptr, GL_STREAM_DRAW);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, particle_count * sizeof(PVertex), particle_data);
+		glBindBuffer(GL_ARRAY_BUFFER, particle_stream->get_buffer());
 		// bind vertex position
 		auto pos_id = particle_program->attr(Renderer::at_pos);
 		glEnableVertexAttribArray(pos_id);
 		glVertexAttribPointer(pos_id, 4, GL_FLOAT, GL_FALSE, sizeof(PVertex),
-			reinterpret_cast<const GLvoid*>(offsetof(PVertex, px)));
+			reinterpret_cast<const GLvoid*>(offset + offsetof(PVertex, px)));
 		// bind color position
 		auto color_id = particle_program->attr(Renderer::at_color);
 		glEnableVertexAttribArray(color_id);
 		glVertexAttribPointer(color_id, 4, GL_FLOAT, GL_FALSE, sizeof(PVertex),
-			reinterpret_cast<const GLvoid*>(offsetof(PVertex, cr)));
+			reinterpret_cast<const GLvoid*>(offset + offsetof(PVertex, cr)));
 #else
 		glEnableClientState(GL_VERTEX_ARRAY);
 		glEnableClientState(GL_COLOR_ARRAY);
-		glBindBuffer(GL_ARRAY_BUFFER, particle_buffer->buffers[0]);
-
-		// Orphan buffer to improve streaming performance
-		glBufferData(GL_ARRAY_BUFFER, Renderer2::max_particles * sizeof(PVertex), NULL, GL_STREAM_DRAW);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, particle_count * sizeof(PVertex), particle_data);
+		glBindBuffer(GL_ARRAY_BUFFER, particle_stream->get_buffer());
 
 		// bind vertex position
 		glVertexPointer(4, GL_FLOAT, sizeof(PVertex),
-			reinterpret_cast<const GLvoid*>(offsetof(PVertex, px)));
+			reinterpret_cast<const GLvoid*>(offset + offsetof(PVertex, px)));
 		// bind color position
 		glColorPointer(4, GL_FLOAT, sizeof(PVertex),
-			reinterpret_cast<const GLvoid*>(offsetof(PVertex, cr)));
+			reinterpret_cast<const GLvoid*>(offset + offsetof(PVertex, cr)));
 #endif
 
 		glDrawArrays(GL_POINTS, 0, particle_count);
@@ -78,7 +78,7 @@ namespace dukat
 	}
 
 	GLuint ShaderCache::build_program(const std::string& vertex_file, const std::string& fragment_file,
-			const std::string& geometry_file)
+			const std::string& geometry_file, const std::vector<std::string>& varyings)
 	{
 		auto program = glCreateProgram();
 		auto vertex_shader = build_shader(GL_VERTEX_SHADER, vertex_file);
@@ -101,6 +101,16 @@ namespace dukat
 		// tell opengl the name of the output variable of the fragment shader
 		// 0 means buffer 0, see http://www.opengl.org/wiki/GLAPI/glDrawBuffers
 		glBindFragDataLocation(program, 0, "outColor");
+#endif
+#if OPENGL_VERSION >= 30
+		// varyings have to be known before linking
+		if (!varyings.empty())
+		{
+			std::vector<const GLchar*> names;
+			for (const auto& v : varyings)
+				names.push_back(v.c_str());
+			glTransformFeedbackVaryings(program, static_cast<GLsizei>(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+		}
 #endif
 		glLinkProgram(program);
 
@@ -139,4 +149,18 @@ namespace dukat
 		}
 		return programs[key].get();
 	}
+
+	ShaderProgram* ShaderCache::get_feedback_program(const std::string& vertex_file, const std::string& fragment_file,
+		const std::vector<std::string>& varyings)
+	{
+		std::string key = vertex_file + "|" + fragment_file + "|";
+		for (const auto& v : varyings)
+			key += "|" + v;
+		if (programs.count(key) == 0)
+		{
+			auto program = build_program(vertex_file, fragment_file, "", varyings);
+			programs[key] = std::make_unique<ShaderProgram>(program);
+		}
+		return programs[key].get();
+	}
 }
\ No newline at end of file
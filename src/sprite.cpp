@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <dukat/aabb2.h>
 #include <dukat/log.h>
 #include <dukat/sprite.h>
 #include <dukat/texturecache.h>
@@ -50,6 +51,39 @@ namespace dukat
 		tex[3] = (float)(rect.h) / (float)texture->h;
 	}
 
+	AABB2 Sprite::bounds(void) const
+	{
+		Vector2 half_dim(scale * w / 2.0f, scale * h / 2.0f);
+		auto min_p = p - half_dim;
+		auto max_p = p + half_dim;
+
+		if (center > 0)
+		{
+			if ((center & align_bottom) == align_bottom)
+			{
+				min_p.y -= (h / 2) * scale;
+				max_p.y -= (h / 2) * scale;
+			}
+			else if ((center & align_top) == align_top)
+			{
+				min_p.y += (h / 2) * scale;
+				max_p.y += (h / 2) * scale;
+			}
+			if ((center & align_right) == align_right)
+			{
+				min_p.x -= (w / 2) * scale;
+				max_p.x -= (w / 2) * scale;
+			}
+			else if ((center & align_left) == align_left)
+			{
+				min_p.x += (w / 2) * scale;
+				max_p.x += (w / 2) * scale;
+			}
+		}
+
+		return AABB2{ min_p, max_p };
+	}
+
 	void Sprite::set_index(int index)
 	{
 		this->index = index;
@@ -0,0 +1,269 @@
+#include "stdafx.h"
+#include <dukat/spritechunkcache.h>
+#include <dukat/buffers.h>
+#include <dukat/mathutil.h>
+#include <dukat/meshdata.h>
+#include <dukat/perfcounter.h>
+#include <dukat/renderer2.h>
+#include <dukat/shaderprogram.h>
+#include <dukat/sprite.h>
+#include <dukat/vertextypes2.h>
+
+namespace dukat
+{
+	// Corners of a sprite quad and matching texture coordinates, as two triangles.
+	static const Vertex2PT quad_vertices[] = {
+		{ -0.5f, -0.5f, 0.0f, 0.0f },
+		{ -0.5f,  0.5f, 0.0f, 1.0f },
+		{ 0.5f, -0.5f, 1.0f, 0.0f },
+		{ 0.5f, -0.5f, 1.0f, 0.0f },
+		{ -0.5f,  0.5f, 0.0f, 1.0f },
+		{ 0.5f,  0.5f, 1.0f, 1.0f }
+	};
+	static constexpr int vertices_per_sprite = 6;
+
+	SpriteChunkCache::SpriteChunkCache(ShaderProgram* program, float chunk_size) : chunk_size(chunk_size), program(program)
+	{
+	}
+
+	SpriteChunkCache::~SpriteChunkCache(void)
+	{
+	}
+
+	SpriteChunkCache::ChunkKey SpriteChunkCache::chunk_key(const Sprite* sprite) const
+	{
+		const auto center = sprite->bounds().center();
+		const auto z = static_cast<uint32_t>(sprite->sort_key() >> 32);
+		return std::make_tuple(z, static_cast<int>(std::floor(center.x / chunk_size)),
+			static_cast<int>(std::floor(center.y / chunk_size)));
+	}
+
+	void SpriteChunkCache::add(Sprite* sprite)
+	{
+		const auto key = chunk_key(sprite);
+		auto& chunk = chunks[key];
+		if (chunk == nullptr)
+		{
+			chunk = std::make_unique<Chunk>();
+		}
+		chunk->sprites.push_back(sprite);
+		chunk->dirty = true;
+		locations[sprite] = key;
+	}
+
+	void SpriteChunkCache::remove(Sprite* sprite)
+	{
+		auto it = locations.find(sprite);
+		if (it == locations.end())
+			return;
+		auto cit = chunks.find(it->second);
+		auto& sprites = cit->second->sprites;
+		sprites.erase(std::remove(sprites.begin(), sprites.end(), sprite), sprites.end());
+		if (sprites.empty())
+		{
+			chunks.erase(cit);
+		}
+		else
+		{
+			cit->second->dirty = true;
+		}
+		locations.erase(it);
+	}
+
+	void SpriteChunkCache::update(Sprite* sprite)
+	{
+		auto it = locations.find(sprite);
+		if (it == locations.end())
+			return;
+		if (it->second == chunk_key(sprite))
+		{
+			chunks[it->second]->dirty = true;
+		}
+		else
+		{
+			remove(sprite);
+			add(sprite);
+		}
+	}
+
+	void SpriteChunkCache::clear(void)
+	{
+		chunks.clear();
+		locations.clear();
+	}
+
+	void SpriteChunkCache::bake(Chunk& chunk)
+	{
+		// group by texture, keeping the order of sprites added first
+		std::stable_sort(chunk.sprites.begin(), chunk.sprites.end(), [](const Sprite* a, const Sprite* b) {
+			return a->texture_id < b->texture_id;
+		});
+
+		std::vector<Vertex2PCT> vertices(chunk.sprites.size() * vertices_per_sprite);
+		chunk.runs.clear();
+		chunk.bb.clear();
+		auto v = vertices.data();
+		for (auto sprite : chunk.sprites)
+		{
+			if (chunk.runs.empty() || chunk.runs.back().texture != sprite->texture_id)
+			{
+				const auto first = static_cast<GLint>(v - vertices.data());
+				chunk.runs.push_back(Run{ sprite->texture_id, first, 0 });
+			}
+			chunk.runs.back().count += vertices_per_sprite;
+
+			const auto bb = sprite->bounds();
+			auto pos = bb.center();
+			if (sprite->pixel_aligned)
+			{
+				pos.x = std::round(pos.x);
+				pos.y = std::round(pos.y);
+			}
+			const Vector2 size{ sprite->scale * sprite->w, sprite->scale * sprite->h };
+			float s = 0.0f, c = 1.0f;
+			if (sprite->rot != 0.0f)
+			{
+				sin_cos(s, c, sprite->rot);
+			}
+
+			for (const auto& q : quad_vertices)
+			{
+				const auto x = q.px * size.x;
+				const auto y = q.py * size.y;
+				v->px = pos.x + c * x - s * y;
+				v->py = pos.y + s * x + c * y;
+				v->cr = sprite->color.r;
+				v->cg = sprite->color.g;
+				v->cb = sprite->color.b;
+				v->ca = sprite->color.a;
+				v->tu = sprite->tex[0] + sprite->tex[2] * q.tu;
+				v->tv = sprite->tex[1] + sprite->tex[3] * q.tv;
+				chunk.bb.add(Vector2{ v->px, v->py });
+				++v;
+			}
+			sprite->rendered = chunk.visible;
+		}
+
+		if (chunk.buffer == nullptr)
+		{
+			chunk.buffer = std::make_unique<VertexBuffer>(1);
+		}
+		chunk.buffer->load_data(0, GL_ARRAY_BUFFER, static_cast<int>(vertices.size()), sizeof(Vertex2PCT),
+			vertices.data(), GL_STATIC_DRAW);
+		chunk.dirty = false;
+	}
+
+	bool SpriteChunkCache::prepare(const AABB2& camera_bb)
+	{
+		auto any_visible = false;
+		for (auto& it : chunks)
+		{
+			auto& chunk = *it.second;
+			if (chunk.dirty)
+			{
+				bake(chunk);
+			}
+
+			const auto visible = camera_bb.overlaps(chunk.bb);
+			if (visible != chunk.visible)
+			{
+				// only touch sprites of chunks that entered or left the screen
+				for (auto sprite : chunk.sprites)
+				{
+					sprite->rendered = visible;
+				}
+				chunk.visible = visible;
+			}
+			any_visible |= visible;
+		}
+		return any_visible;
+	}
+
+	void SpriteChunkCache::render(Renderer2* renderer, float parallax, uint64_t z_begin, uint64_t z_end)
+	{
+		if (z_begin >= z_end)
+			return;
+		// chunks are ordered by z key first
+		const auto first = chunks.lower_bound(std::make_tuple(static_cast<uint32_t>(z_begin), INT_MIN, INT_MIN));
+		const auto last = z_end > UINT32_MAX ? chunks.end()
+			: chunks.lower_bound(std::make_tuple(static_cast<uint32_t>(z_end), INT_MIN, INT_MIN));
+		const auto any_visible = std::any_of(first, last, [](const std::pair<const ChunkKey, std::unique_ptr<Chunk>>& it) {
+			return it.second->visible;
+		});
+		if (!any_visible)
+			return;
+
+		renderer->switch_shader(program);
+		glUniform1f(program->attr("u_parallax"), parallax);
+		glUniform1i(program->attr(Renderer::uf_tex0), 0);
+
+#if OPENGL_VERSION >= 30
+		auto pos_id = program->attr(Renderer::at_pos);
+		auto color_id = program->attr(Renderer::at_color);
+		auto uv_id = program->attr(Renderer::at_texcoord);
+#else
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+#endif
+
+		GLuint last_texture = -1;
+		for (auto it = first; it != last; ++it)
+		{
+			const auto& chunk = *it->second;
+			if (!chunk.visible)
+				continue;
+
+#if OPENGL_VERSION >= 30
+			glBindVertexArray(chunk.buffer->vao);
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer->buffers[0]);
+			glEnableVertexAttribArray(pos_id);
+			glVertexAttribPointer(pos_id, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, px)));
+			glEnableVertexAttribArray(color_id);
+			glVertexAttribPointer(color_id, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, cr)));
+			glEnableVertexAttribArray(uv_id);
+			glVertexAttribPointer(uv_id, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, tu)));
+#else
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer->buffers[0]);
+			glVertexPointer(2, GL_FLOAT, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, px)));
+			glColorPointer(4, GL_FLOAT, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, cr)));
+			glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex2PCT),
+				reinterpret_cast<const GLvoid*>(offsetof(Vertex2PCT, tu)));
+#endif
+
+			for (const auto& run : chunk.runs)
+			{
+				// switch texture if necessary
+				if (last_texture != run.texture)
+				{
+					perfc.inc(PerformanceCounter::TEXTURES);
+					glActiveTexture(GL_TEXTURE0);
+					glBindTexture(GL_TEXTURE_2D, run.texture);
+					last_texture = run.texture;
+				}
+				glDrawArrays(GL_TRIANGLES, run.first, run.count);
+				perfc.inc(PerformanceCounter::DRAW_CALLS);
+			}
+			perfc.inc(PerformanceCounter::SPRITES, static_cast<int>(chunk.sprites.size()));
+		}
+
+#ifdef _DEBUG
+	#if OPENGL_VERSION >= 30
+		glDisableVertexAttribArray(pos_id);
+		glDisableVertexAttribArray(color_id);
+		glDisableVertexAttribArray(uv_id);
+		glBindVertexArray(0);
+	#else
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	#endif
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+	}
+}
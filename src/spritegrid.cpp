@@ -0,0 +1,57 @@
+#include "stdafx.h"
+#include <dukat/spritegrid.h>
+#include <dukat/sprite.h>
+
+namespace dukat
+{
+	void SpriteGrid::insert(Sprite* sprite)
+	{
+		const auto bb = sprite->bounds();
+		const auto center = bb.center();
+		const auto key = cell_key(cell_coord(center.x), cell_coord(center.y));
+		cells[key].push_back(sprite);
+		locations[sprite] = key;
+		max_extent.x = std::max(max_extent.x, 0.5f * bb.width());
+		max_extent.y = std::max(max_extent.y, 0.5f * bb.height());
+	}
+
+	void SpriteGrid::remove(Sprite* sprite)
+	{
+		auto it = locations.find(sprite);
+		if (it == locations.end())
+			return;
+		auto cell = cells.find(it->second);
+		auto& sprites = cell->second;
+		sprites.erase(std::remove(sprites.begin(), sprites.end(), sprite), sprites.end());
+		if (sprites.empty())
+		{
+			cells.erase(cell);
+		}
+		locations.erase(it);
+	}
+
+	void SpriteGrid::update(Sprite* sprite)
+	{
+		auto it = locations.find(sprite);
+		if (it == locations.end())
+			return;
+		const auto bb = sprite->bounds();
+		const auto center = bb.center();
+		const auto key = cell_key(cell_coord(center.x), cell_coord(center.y));
+		max_extent.x = std::max(max_extent.x, 0.5f * bb.width());
+		max_extent.y = std::max(max_extent.y, 0.5f * bb.height());
+		if (key == it->second)
+			return; // still in the same cell
+
+		remove(sprite);
+		cells[key].push_back(sprite);
+		locations[sprite] = key;
+	}
+
+	void SpriteGrid::clear(void)
+	{
+		cells.clear();
+		locations.clear();
+		max_extent = Vector2{ 0.0f, 0.0f };
+	}
+}
@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include <dukat/streambuffer.h>
+#include <dukat/log.h>
+
+namespace dukat
+{
+	// Alignment of each mapped range within a region.
+	static constexpr GLsizeiptr map_alignment = 16;
+
+	StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr region_size, int region_count)
+		: target(target), region_size(region_size), region_count(region_count), mode(ORPHAN),
+		mapped(nullptr), region(0), head(0), range_mapped(false)
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+
+#ifdef STREAM_BUFFER_SYNC
+		fences.resize(region_count, nullptr);
+		const auto total_size = region_size * region_count;
+	#ifdef OPENGL_CORE
+		if (GLEW_ARB_buffer_storage)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, total_size, nullptr, flags);
+			mapped = static_cast<GLubyte*>(glMapBufferRange(target, 0, total_size, flags));
+		}
+	#endif
+		if (mapped != nullptr)
+		{
+			mode = PERSISTENT;
+		}
+		else
+		{
+			glBufferData(target, total_size, nullptr, GL_STREAM_DRAW);
+			mode = UNSYNCHRONIZED;
+		}
+#endif
+		log->debug("Created {}x{} byte stream buffer in mode {}.", region_count, region_size, static_cast<int>(mode));
+	}
+
+	StreamBuffer::~StreamBuffer(void)
+	{
+#ifdef STREAM_BUFFER_SYNC
+		for (auto fence : fences)
+		{
+			if (fence != nullptr)
+				glDeleteSync(fence);
+		}
+#endif
+		if (mapped != nullptr)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	void StreamBuffer::begin_frame(void)
+	{
+		region = (region + 1) % region_count;
+		head = 0;
+#ifdef STREAM_BUFFER_SYNC
+		auto& fence = fences[region];
+		if (fence == nullptr)
+			return;
+		// Only blocks if the CPU is more than region_count frames ahead of the GPU
+		while (true)
+		{
+			const auto res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED || res == GL_WAIT_FAILED)
+				break;
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+#endif
+	}
+
+	void StreamBuffer::end_frame(void)
+	{
+#ifdef STREAM_BUFFER_SYNC
+		if (head > 0)
+		{
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+#endif
+	}
+
+	GLvoid* StreamBuffer::map(GLsizeiptr& size, GLintptr& offset)
+	{
+		glBindBuffer(target, buffer);
+		if (mode == ORPHAN)
+		{
+			// every write starts a new buffer, so the region is never full;
+			// staging only grows to the largest write actually requested
+			size = std::min(size, region_size);
+			if (static_cast<GLsizeiptr>(staging.size()) < size)
+				staging.resize(size);
+			offset = 0;
+			return staging.data();
+		}
+
+		head = (head + map_alignment - 1) / map_alignment * map_alignment;
+		size = std::min(size, region_size - head);
+		if (size <= 0)
+		{
+			size = 0;
+			return nullptr;
+		}
+		offset = region * region_size + head;
+
+#ifdef STREAM_BUFFER_SYNC
+		if (mode == PERSISTENT)
+		{
+			return mapped + offset;
+		}
+		// fences already guarantee that the GPU is done with this range
+		auto ptr = glMapBufferRange(target, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		range_mapped = ptr != nullptr;
+		return ptr;
+#else
+		return nullptr;
+#endif
+	}
+
+	void StreamBuffer::unmap(GLsizeiptr size)
+	{
+		switch (mode)
+		{
+		case ORPHAN:
+			// Orphan buffer so that pending draws keep their copy, and
+			// only allocate what was written
+			if (size > 0)
+			{
+				glBindBuffer(target, buffer);
+				glBufferData(target, size, staging.data(), GL_STREAM_DRAW);
+			}
+			break;
+#ifdef STREAM_BUFFER_SYNC
+		case UNSYNCHRONIZED:
+			if (!range_mapped)
+				break;
+			glBindBuffer(target, buffer);
+			if (size > 0)
+			{
+				glFlushMappedBufferRange(target, 0, size);
+			}
+			glUnmapBuffer(target);
+			range_mapped = false;
+			head += size;
+			break;
+#endif
+		default:
+			head += size;
+			break;
+		}
+	}
+}
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+#include <dukat/textureatlas.h>
+#include <dukat/assetloader.h>
+#include <dukat/log.h>
+#include <dukat/sprite.h>
+#include <dukat/surface.h>
+#include <algorithm>
+
+namespace dukat
+{
+	// Format used for pages and all images copied into them.
+	static constexpr Uint32 page_format = SDL_PIXELFORMAT_RGBA8888;
+
+	SkylinePacker::SkylinePacker(int width, int height) : width(width), height(height), used_area(0)
+	{
+		clear();
+	}
+
+	void SkylinePacker::clear(void)
+	{
+		skyline.clear();
+		skyline.push_back(Segment{ 0, 0, width });
+		used_area = 0;
+	}
+
+	int SkylinePacker::fit(int i, int w, int h) const
+	{
+		if (skyline[i].x + w > width)
+			return -1;
+		// rectangle rests on the highest segment it spans
+		auto y = skyline[i].y;
+		auto width_left = w;
+		for (auto j = i; width_left > 0; j++)
+		{
+			y = std::max(y, skyline[j].y);
+			if (y + h > height)
+				return -1;
+			width_left -= skyline[j].w;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::insert(int w, int h, Rect& r)
+	{
+		auto best_index = -1;
+		auto best_bottom = height + 1;
+		auto best_width = width + 1;
+		for (auto i = 0; i < static_cast<int>(skyline.size()); i++)
+		{
+			const auto y = fit(i, w, h);
+			if (y < 0)
+				continue;
+			// prefer the lowest position, then the narrowest segment
+			if (y + h < best_bottom || (y + h == best_bottom && skyline[i].w < best_width))
+			{
+				best_index = i;
+				best_bottom = y + h;
+				best_width = skyline[i].w;
+				r = Rect{ skyline[i].x, y, w, h };
+			}
+		}
+		if (best_index < 0)
+			return false;
+		place(best_index, r);
+		return true;
+	}
+
+	void SkylinePacker::place(int i, const Rect& r)
+	{
+		skyline.insert(skyline.begin() + i, Segment{ r.x, r.y + r.h, r.w });
+
+		// shrink or remove segments now covered by the new one
+		for (auto j = i + 1; j < static_cast<int>(skyline.size()); )
+		{
+			const auto& prev = skyline[j - 1];
+			const auto overlap = prev.x + prev.w - skyline[j].x;
+			if (overlap <= 0)
+				break;
+			skyline[j].x += overlap;
+			skyline[j].w -= overlap;
+			if (skyline[j].w > 0)
+				break;
+			skyline.erase(skyline.begin() + j);
+		}
+
+		// merge neighbors at the same height
+		for (auto j = 1; j < static_cast<int>(skyline.size()); )
+		{
+			if (skyline[j - 1].y == skyline[j].y)
+			{
+				skyline[j - 1].w += skyline[j].w;
+				skyline.erase(skyline.begin() + j);
+			}
+			else
+			{
+				j++;
+			}
+		}
+
+		used_area += r.w * r.h;
+	}
+
+	TextureAtlas::TextureAtlas(int page_width, int page_height, int padding)
+		: page_width(page_width), page_height(page_height), padding(padding), first_open_page(0)
+	{
+	}
+
+	TextureAtlas::~TextureAtlas(void)
+	{
+	}
+
+	void TextureAtlas::add(const std::string& name, std::unique_ptr<Surface> surface)
+	{
+		if (surface->get_surface()->format->format != page_format)
+		{
+			surface->convert_format(page_format);
+		}
+		pending.push_back(std::make_pair(name, std::move(surface)));
+	}
+
+	void TextureAtlas::add(const std::string& name, const Surface& surface)
+	{
+		auto copy = SDL_ConvertSurfaceFormat(surface.get_surface(), page_format, 0);
+		if (copy == nullptr)
+		{
+			throw std::runtime_error("Could not copy surface: " + name);
+		}
+		pending.push_back(std::make_pair(name, std::make_unique<Surface>(copy)));
+	}
+
+	void TextureAtlas::add_file(const std::string& filename)
+	{
+		add(filename, Surface::from_file(filename));
+	}
+
+	void TextureAtlas::build(TextureFilterProfile profile)
+	{
+		if (pending.empty())
+			return;
+
+		// placing tall images first keeps the skyline flat
+		std::stable_sort(pending.begin(), pending.end(), [](const auto& a, const auto& b) {
+			const auto sa = a.second->get_surface();
+			const auto sb = b.second->get_surface();
+			return sa->h > sb->h || (sa->h == sb->h && sa->w > sb->w);
+		});
+
+		std::vector<bool> changed(page_surfaces.size(), false);
+		for (auto& it : pending)
+		{
+			auto src = it.second->get_surface();
+			const auto w = src->w + 2 * padding;
+			const auto h = src->h + 2 * padding;
+			if (w > page_width || h > page_height)
+			{
+				throw std::runtime_error("Image does not fit into atlas page: " + it.first);
+			}
+
+			Rect r;
+			auto packer = 0;
+			while (packer < static_cast<int>(packers.size()) && !packers[packer].insert(w, h, r))
+			{
+				packer++;
+			}
+			if (packer == static_cast<int>(packers.size()))
+			{
+				packers.emplace_back(page_width, page_height);
+				packers.back().insert(w, h, r);
+				page_surfaces.push_back(std::make_unique<Surface>(page_width, page_height, page_format));
+				changed.push_back(true);
+			}
+
+			const auto page = first_open_page + packer;
+			const Rect dest{ r.x + padding, r.y + padding, src->w, src->h };
+			const Rect src_rect{ 0, 0, src->w, src->h };
+			// copy pixels as they are instead of blending them onto the page
+			SDL_SetSurfaceBlendMode(src, SDL_BLENDMODE_NONE);
+			page_surfaces[page]->blend(*it.second, src_rect, dest);
+			changed[page] = true;
+
+			entries[it.first] = Entry{ page, dest };
+		}
+		pending.clear();
+
+		for (auto i = 0u; i < changed.size(); i++)
+		{
+			if (!changed[i])
+				continue;
+			if (i < pages.size())
+			{
+				pages[i]->load_data(*page_surfaces[i], profile);
+			}
+			else
+			{
+				pages.push_back(std::make_unique<Texture>(*page_surfaces[i], profile));
+			}
+		}
+
+		for (auto i = 0u; i < packers.size(); i++)
+		{
+			log->debug("Atlas page {}: {:.1f}% used.", first_open_page + i, 100.0f * packers[i].occupancy());
+		}
+	}
+
+	void TextureAtlas::save(const std::string& base) const
+	{
+		for (auto i = 0u; i < page_surfaces.size(); i++)
+		{
+			if (page_surfaces[i] == nullptr)
+			{
+				throw std::runtime_error("Cannot save atlas after surfaces have been discarded.");
+			}
+			page_surfaces[i]->save_to_file(base + "_" + std::to_string(i) + ".png");
+		}
+
+		std::fstream os(base + ".atlas", std::fstream::out | std::fstream::trunc);
+		if (!os)
+		{
+			throw std::runtime_error("Could not write file: " + base + ".atlas");
+		}
+		os << "size " << page_width << " " << page_height << std::endl;
+		os << "pages " << page_surfaces.size() << std::endl;
+		for (const auto& it : entries)
+		{
+			const auto& e = it.second;
+			os << "entry " << e.page << " " << e.rect.x << " " << e.rect.y << " "
+				<< e.rect.w << " " << e.rect.h << " " << it.first << std::endl;
+		}
+	}
+
+	void TextureAtlas::load(const std::string& base, TextureFilterProfile profile)
+	{
+		std::stringstream ss;
+		AssetLoader loader;
+		loader.load_text(base + ".atlas", ss);
+
+		pending.clear();
+		entries.clear();
+		packers.clear();
+		page_surfaces.clear();
+		pages.clear();
+
+		auto page_total = 0;
+		auto width = 0, height = 0;
+		std::string line;
+		while (std::getline(ss, line))
+		{
+			std::stringstream ls(line);
+			std::string key;
+			ls >> key;
+			if (key == "size")
+			{
+				ls >> width >> height;
+			}
+			else if (key == "pages")
+			{
+				ls >> page_total;
+			}
+			else if (key == "entry")
+			{
+				Entry e;
+				ls >> e.page >> e.rect.x >> e.rect.y >> e.rect.w >> e.rect.h;
+				// name is the remainder of the line and may contain spaces
+				std::string name;
+				std::getline(ls >> std::ws, name);
+				entries[name] = e;
+			}
+		}
+
+		for (auto i = 0; i < page_total; i++)
+		{
+			const auto filename = base + "_" + std::to_string(i) + ".png";
+			auto surface = Surface::from_file(filename);
+			if (surface->get_width() != width || surface->get_height() != height)
+			{
+				throw std::runtime_error("Atlas page does not match size in atlas file: " + filename);
+			}
+			if (surface->get_surface()->format->format != page_format)
+			{
+				surface->convert_format(page_format);
+			}
+			pages.push_back(std::make_unique<Texture>(*surface, profile));
+			page_surfaces.push_back(std::move(surface));
+		}
+		// free space of loaded pages is unknown, so new images go to new pages
+		first_open_page = page_total;
+	}
+
+	void TextureAtlas::discard_surfaces(void)
+	{
+		// keep slots so surfaces stay indexed by page
+		for (auto& surface : page_surfaces)
+		{
+			surface = nullptr;
+		}
+		packers.clear();
+		first_open_page = static_cast<int>(pages.size());
+	}
+
+	const TextureAtlas::Entry* TextureAtlas::find(const std::string& name) const
+	{
+		auto it = entries.find(name);
+		return it == entries.end() ? nullptr : &it->second;
+	}
+
+	std::unique_ptr<Sprite> TextureAtlas::create_sprite(const std::string& name) const
+	{
+		auto entry = find(name);
+		if (entry == nullptr)
+		{
+			throw std::runtime_error("Unknown atlas entry: " + name);
+		}
+		return std::make_unique<Sprite>(pages[entry->page].get(), entry->rect);
+	}
+}
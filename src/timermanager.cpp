@@ -1,52 +1,192 @@
 #include "stdafx.h"
 #include <dukat/timermanager.h>
+#include <dukat/profiler.h>
 
 namespace dukat
 {
-    Timer* TimerManager::create_timer(float interval, std::function<void(void)> callback, bool recurring)
-    {
-        auto timer = std::make_unique<Timer>(++last_id, interval, callback, recurring);
-        auto res = timer.get();
-        timers.push_back(std::move(timer));
-		return res;
-    }
-    
-    void TimerManager::cancel_timer(Timer* timer)
-    {
-        auto it = std::find_if(timers.begin(), timers.end(), [timer](const std::unique_ptr<Timer>& ptr) {
-            return ptr.get() == timer;
-        });
-        if (it != timers.end())
-        {
-            timers.erase(it);
-        }
-    }
-
-    void TimerManager::update(float delta)
-    {
-        for (auto it = timers.begin(); it != timers.end(); )
-        {
-            (*it)->remaining -= delta;
-            // check if timer has expired
-            if ((*it)->remaining <= 0.0f)
-            {
-                if ((*it)->callback)
-                {
-                    (*it)->callback();
-                }
-
-                if ((*it)->recurring)
-                {
-                    (*it)->remaining = (*it)->interval;
-                }
-                else
-                {
-                    it = timers.erase(it);
-                    continue;
-                }
-            }
-
-            ++it;
-        }
-    }
-}
\ No newline at end of file
+	constexpr int TimerManager::wheel_bits;
+	constexpr int TimerManager::wheel_size;
+	constexpr int TimerManager::wheel_levels;
+	constexpr double TimerManager::ticks_per_second;
+
+	TimerManager::TimerManager(GameBase* game) : Manager(game), last_id(0u), waiting(nullptr), expiring(nullptr), running(nullptr), time(0.0), tick(0u)
+	{
+		for (auto& level : wheel)
+			level.fill(nullptr);
+	}
+
+	TimerHandle TimerManager::create_timer(float interval, std::function<void(void)> callback, bool recurring)
+	{
+		auto timer = timers.create(++last_id, interval, callback, recurring);
+		timer->deadline = time + static_cast<double>(interval);
+		schedule(timer);
+		return TimerHandle{ timer, timer->id };
+	}
+
+	void TimerManager::cancel_timer(const TimerHandle& handle)
+	{
+		auto timer = handle.timer;
+		// stale handle, the slot is free or holds another timer by now
+		if (timer == nullptr || !timers.is_live(timer) || timer->id != handle.id)
+			return;
+
+		if (timer == running)
+		{
+			// released once the callback returns
+			timer->cancelled = true;
+		}
+		else if (timer->pprev != nullptr)
+		{
+			unlink(timer);
+			timers.destroy(timer);
+		}
+	}
+
+	void TimerManager::schedule(Timer* timer)
+	{
+		const auto expires = static_cast<uint64_t>(timer->deadline * ticks_per_second);
+		if (expires <= current_tick())
+		{
+			// the wheel has already passed this tick, check again next update
+			timer->expires = expires;
+			link(waiting, timer);
+		}
+		else
+		{
+			place(timer, expires);
+		}
+	}
+
+	void TimerManager::place(Timer* timer, uint64_t expires)
+	{
+		timer->expires = expires;
+		// use the finest level whose range covers the distance to the tick
+		const auto distance = expires - tick;
+		auto level = 0;
+		while (level < wheel_levels && (distance >> (wheel_bits * (level + 1))) != 0u)
+			level++;
+		if (level == wheel_levels)
+		{
+			// beyond the range of the wheel, park in the last slot and reschedule from there
+			level = wheel_levels - 1;
+			expires = tick + (static_cast<uint64_t>(1) << (wheel_bits * wheel_levels)) - 1u;
+		}
+		link(wheel[level][(expires >> (wheel_bits * level)) & (wheel_size - 1)], timer);
+	}
+
+	void TimerManager::link(Timer*& head, Timer* timer)
+	{
+		timer->next = head;
+		if (head != nullptr)
+			head->pprev = &timer->next;
+		head = timer;
+		timer->pprev = &head;
+	}
+
+	void TimerManager::unlink(Timer* timer)
+	{
+		*timer->pprev = timer->next;
+		if (timer->next != nullptr)
+			timer->next->pprev = timer->pprev;
+		timer->next = nullptr;
+		timer->pprev = nullptr;
+	}
+
+	void TimerManager::cascade(int level)
+	{
+		auto& head = wheel[level][(tick >> (wheel_bits * level)) & (wheel_size - 1)];
+		auto timer = head;
+		head = nullptr;
+		while (timer != nullptr)
+		{
+			auto next = timer->next;
+			place(timer, std::max(timer->expires, tick));
+			timer = next;
+		}
+	}
+
+	void TimerManager::expire(Timer*& head)
+	{
+		// detach the list, so callbacks can schedule and cancel freely
+		expiring = head;
+		head = nullptr;
+		if (expiring != nullptr)
+			expiring->pprev = &expiring;
+
+		while (expiring != nullptr)
+		{
+			auto timer = expiring;
+			unlink(timer);
+			if (timer->expires > tick || timer->deadline > time)
+			{
+				// parked beyond the wheel's range, or due later during this tick
+				schedule(timer);
+				continue;
+			}
+
+			running = timer;
+			if (timer->callback)
+			{
+				timer->callback();
+			}
+			running = nullptr;
+
+			if (timer->recurring && !timer->cancelled)
+			{
+				timer->deadline += static_cast<double>(timer->interval);
+				if (timer->deadline <= time)
+				{
+					// skip intervals that have been missed entirely
+					timer->deadline = timer->interval > 0.0f
+						? timer->deadline + timer->interval * std::floor((time - timer->deadline) / timer->interval + 1.0)
+						: time;
+				}
+				schedule(timer);
+			}
+			else
+			{
+				timers.destroy(timer);
+			}
+		}
+	}
+
+	void TimerManager::update(float delta)
+	{
+		ProfileZone zone("TimerManager::update");
+		time += static_cast<double>(delta);
+		expire(waiting);
+		const auto target = current_tick();
+		while (tick < target)
+		{
+			tick++;
+			for (auto level = 1; level < wheel_levels; level++)
+			{
+				if ((tick & ((static_cast<uint64_t>(1) << (wheel_bits * level)) - 1u)) != 0u)
+					break;
+				cascade(level);
+			}
+			expire(wheel[0][tick & (wheel_size - 1)]);
+		}
+	}
+
+	void TimerManager::clear(void)
+	{
+		auto clear_list = [&](Timer*& head) {
+			while (head != nullptr)
+			{
+				auto timer = head;
+				unlink(timer);
+				timers.destroy(timer);
+			}
+		};
+		for (auto& level : wheel)
+		{
+			for (auto& head : level)
+				clear_list(head);
+		}
+		clear_list(waiting);
+		clear_list(expiring);
+		if (running != nullptr)
+			running->cancelled = true;
+	}
+}
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include <dukat/workerpool.h>
+#include <dukat/profiler.h>
+
+namespace dukat
+{
+	WorkerPool::WorkerPool(int num_workers) : job(nullptr), job_count(0), next_job(0), completed_jobs(0),
+		active_workers(0), batch(0), stopping(false)
+	{
+		if (num_workers < 0)
+		{
+			const auto hw_threads = static_cast<int>(std::thread::hardware_concurrency());
+			num_workers = std::max(0, hw_threads - 1);
+		}
+		for (auto i = 0; i < num_workers; i++)
+		{
+			workers.push_back(std::thread(&WorkerPool::worker_loop, this));
+		}
+	}
+
+	WorkerPool::~WorkerPool(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		work_cv.notify_all();
+		for (auto& t : workers)
+		{
+			t.join();
+		}
+	}
+
+	void WorkerPool::worker_loop(void)
+	{
+		uint32_t last_batch = 0;
+		while (true)
+		{
+			const std::function<void(int)>* fn;
+			int count;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				work_cv.wait(lock, [&] { return stopping || batch != last_batch; });
+				if (stopping)
+					return;
+				last_batch = batch;
+				// batch may have been completed before this worker woke up
+				if (job == nullptr)
+					continue;
+				fn = job;
+				count = job_count;
+				active_workers++;
+			}
+
+			run_jobs(*fn, count);
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				active_workers--;
+			}
+			done_cv.notify_all();
+		}
+	}
+
+	void WorkerPool::run_jobs(const std::function<void(int)>& fn, int count)
+	{
+		ProfileZone zone("WorkerPool::run_jobs");
+		int i;
+		while ((i = next_job.fetch_add(1)) < count)
+		{
+			fn(i);
+			completed_jobs.fetch_add(1);
+		}
+	}
+
+	void WorkerPool::parallel_for(int count, const std::function<void(int)>& fn)
+	{
+		if (count <= 0)
+			return;
+
+		if (workers.empty() || count == 1)
+		{
+			for (auto i = 0; i < count; i++)
+			{
+				fn(i);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			job = &fn;
+			job_count = count;
+			next_job = 0;
+			completed_jobs = 0;
+			batch++;
+		}
+		work_cv.notify_all();
+
+		run_jobs(fn, count);
+
+		// Wait until all jobs are done and no worker holds on to this batch anymore.
+		std::unique_lock<std::mutex> lock(mtx);
+		done_cv.wait(lock, [&] { return completed_jobs.load() == count && active_workers == 0; });
+		job = nullptr;
+	}
+}